@@ -52,4 +52,20 @@ TEST(arena_tests, alloc_sanity)
     ASSERT_EQ(arena_available(&arena), 0);
     ASSERT_EQ(arena_occupied(&arena), sizeof(data));
     ASSERT_EQ(arena_alloc(&arena, 1), NULL);
-}
\ No newline at end of file
+}
+
+
+TEST(arena_tests, alloc_aligned_sanity)
+{
+    arena_t arena;
+    _Alignas(16) char data[64];
+    arena_init(&arena, data, sizeof(data));
+    arena_alloc(&arena, 1);
+    char *aligned = arena_alloc_aligned(&arena, 8, 16);
+    ASSERT_TRUE(aligned == data + 16);
+    ASSERT_EQ(arena_occupied(&arena), 24);
+    ASSERT_TRUE(arena_alloc_aligned(&arena, 40, 16) == NULL);
+    ASSERT_EQ(arena_occupied(&arena), 24);
+    ASSERT_TRUE(arena_alloc_aligned(&arena, 32, 16) == data + 32);
+    ASSERT_EQ(arena_available(&arena), 0);
+}
@@ -0,0 +1,76 @@
+#include "ini/ini.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Compares ini_get_values() against the same lookups made one by one
+ * with ini_get_value(). The queries cycle through every section so
+ * that no two neighbours share one, which is the case batching has
+ * to handle by grouping rather than by luck.
+ */
+
+#define SECTIONS 64
+#define PAIRS 64
+#define QUERIES (SECTIONS * PAIRS)
+#define ROUNDS 200
+
+
+
+static double now_(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+
+int main(void)
+{
+    static char names[SECTIONS][16];
+    static char keys[PAIRS][16];
+    static INIQuery_t queries[QUERIES];
+    static const char *values[QUERIES];
+
+    static char contents[SECTIONS * (16 + PAIRS * 24)];
+    size_t length = 0;
+    for (int i = 0; i < SECTIONS; i++)
+        snprintf(names[i], sizeof(names[i]), "section%d", i);
+    for (int j = 0; j < PAIRS; j++)
+        snprintf(keys[j], sizeof(keys[j]), "key%d", j);
+    for (int i = 0; i < SECTIONS; i++)
+    {
+        length += snprintf(contents + length, sizeof(contents) - length, "[%s]\n", names[i]);
+        for (int j = 0; j < PAIRS; j++)
+            length += snprintf(contents + length, sizeof(contents) - length, "%s = value\n", keys[j]);
+    }
+
+    INIData_t *data = ini_parse_buffer(contents, length);
+    if (!data || data->error.encountered) return EXIT_FAILURE;
+    for (int q = 0; q < QUERIES; q++)
+        queries[q] = (INIQuery_t){names[q % SECTIONS], keys[q / SECTIONS]};
+
+    // One untimed pass of each so that neither side pays for warming up.
+    size_t found = ini_get_values(data, queries, QUERIES, values);
+    for (int q = 0; q < QUERIES; q++)
+        found += ini_get_value(data, queries[q].section, queries[q].key) != NULL;
+
+    double start = now_();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int q = 0; q < QUERIES; q++)
+            found += ini_get_value(data, queries[q].section, queries[q].key) != NULL;
+    const double single = now_() - start;
+
+    start = now_();
+    for (int r = 0; r < ROUNDS; r++)
+        found += ini_get_values(data, queries, QUERIES, values);
+    const double batched = now_() - start;
+
+    printf("%d lookups x %d rounds (checksum %zu)\n", QUERIES, ROUNDS, found);
+    printf("ini_get_value:  %.3f ms\n", single * 1e3);
+    printf("ini_get_values: %.3f ms\n", batched * 1e3);
+    ini_free(data);
+    return EXIT_SUCCESS;
+}
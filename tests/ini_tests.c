@@ -4,6 +4,10 @@
 
 
 #include <assert.h>
+#include <limits.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
 
 
 
@@ -108,13 +112,16 @@ TEST(ini_tests, sections)
 
     INISection_t section;
     ASSERT_TRUE(ini_parse_section(line, &section, NULL));
-    ASSERT_STREQ(section.name, "section");
+    ASSERT_EQ(section.name_length, 7);
+    ASSERT_TRUE(section.name == line + 1);
 
     ASSERT_TRUE(ini_parse_section(line_spaces, &section, NULL));
-    ASSERT_STREQ(section.name, "section");
+    ASSERT_EQ(section.name_length, 7);
+    ASSERT_TRUE(strncmp(section.name, "section", 7) == 0);
 
     ASSERT_TRUE(ini_parse_section(line_comment, &section, NULL));
-    ASSERT_STREQ(section.name, "section");
+    ASSERT_EQ(section.name_length, 7);
+    ASSERT_TRUE(strncmp(section.name, "section", 7) == 0);
 }
 
 
@@ -191,11 +198,11 @@ TEST(ini_tests, file_writing)
     INIData_t *data = ini_parse_file(input_file);
 
     FILE *output_file = tmpfile();
-    ini_write_file(data, output_file);
+    ASSERT_TRUE(ini_write_file(data, output_file));
     rewind(output_file);
     INIData_t *copy = ini_parse_file(output_file);
     ASSERT_TRUE(copy != NULL);
-    if (copy->sections == NULL)
+    if (copy->error.encountered)
     {
         fprintf(stderr, copy->error.line);
         for (int i = 0; i < copy->error.offset; i++)
@@ -203,17 +210,17 @@ TEST(ini_tests, file_writing)
         fprintf(stderr, "^\n");
         fprintf(stderr, copy->error.msg);
     }
-    ASSERT_TRUE(copy->sections != NULL);
+    ASSERT_FALSE(copy->error.encountered);
 
     ASSERT_EQ(data->section_count, copy->section_count);
 
-    for (int i = 0; i < data->section_count; i++)
+    for (size_t i = 0; i < data->section_count; i++)
     {
-        const INISection_t *section = &data->sections[i];
-        for (int j = 0; j < section->pair_count; j++)
+        const INISection_t *section = ini_section_at(data, i);
+        for (size_t j = 0; j < section->pair_count; j++)
         {
-            const char *key = section->pairs[j].key;
-            const char *value = section->pairs[j].value;
+            const char *key = ini_pair_at(section, j)->key;
+            const char *value = ini_pair_at(section, j)->value;
 
             ASSERT_STREQ(value, ini_get_value(copy, section->name, key));
 
@@ -237,7 +244,7 @@ TEST(ini_tests, parse_error_bad_pair)
     rewind(file);
     INIData_t *data = ini_parse_file(file);
     ASSERT_TRUE(data != NULL);
-    ASSERT_TRUE(data->sections == NULL);
+    ASSERT_EQ(data->section_count, 0);
     ASSERT_TRUE(data->error.encountered);
     ASSERT_STREQ(data->error.line, "bad=pa$ir\n");
     ASSERT_STREQ(data->error.msg, "Failed to parse pair.");
@@ -255,7 +262,7 @@ TEST(ini_tests, parse_error_no_section)
     rewind(file);
     INIData_t *data = ini_parse_file(file);
     ASSERT_TRUE(data != NULL);
-    ASSERT_TRUE(data->sections == NULL);
+    ASSERT_EQ(data->section_count, 0);
     ASSERT_TRUE(data->error.encountered);
     ASSERT_STREQ(data->error.line, "key=value\n");
     ASSERT_STREQ(data->error.msg, "Pairs must reside within a section.");
@@ -273,7 +280,7 @@ TEST(ini_tests, parse_error_bad_section)
     rewind(file);
     INIData_t *data = ini_parse_file(file);
     ASSERT_TRUE(data != NULL);
-    ASSERT_TRUE(data->sections == NULL);
+    ASSERT_EQ(data->section_count, 0);
     ASSERT_TRUE(data->error.encountered);
     ASSERT_STREQ(data->error.line, "[Bad Section]\n");
     ASSERT_STREQ(data->error.msg, "Failed to parse section.");
@@ -292,10 +299,1687 @@ TEST(ini_tests, parse_error_duplicate_section)
     rewind(file);
     INIData_t *data = ini_parse_file(file);
     ASSERT_TRUE(data != NULL);
-    ASSERT_TRUE(data->sections == NULL);
+    ASSERT_EQ(data->section_count, 0);
     ASSERT_TRUE(data->error.encountered);
     ASSERT_STREQ(data->error.line, "[Section]\n");
     ASSERT_STREQ(data->error.msg, "Duplicate section 'Section'.");
     ini_free(data);
     fclose(file);
-}
\ No newline at end of file
+}
+
+
+static void write_temp_file_(char *path, const char *contents, size_t length)
+{
+    const int fd = mkstemp(path);
+    assert(fd >= 0);
+    FILE *file = fdopen(fd, "wb");
+    assert(file);
+    fwrite(contents, 1, length, file);
+    fclose(file);
+}
+
+
+
+TEST(ini_tests, mapped_parsing)
+{
+    const char contents[] = "[section]\n"
+                            "hello = world ; comment\n"
+                            "hi=true\n"
+                            "\n"
+                            "[other]\n"
+                            "this_one=\"is a string\"";
+
+    char path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(path, contents, sizeof(contents) - 1);
+    INIData_t *data = ini_parse_mapped(path);
+    remove(path);
+
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_EQ(data->section_count, 2);
+    ASSERT_STREQ(ini_get_value(data, "section", "hello"), "world");
+    ASSERT_STREQ(ini_get_value(data, "section", "hi"), "true");
+    ASSERT_STREQ(ini_get_value(data, "other", "this_one"), "\"is a string\"");
+    ASSERT_TRUE(ini_get_value(data, "other", "hello") == NULL);
+    ASSERT_EQ(ini_pair_at(ini_section_at(data, 0), 0)->key_length, 5);
+    ASSERT_EQ(ini_pair_at(ini_section_at(data, 0), 0)->value_length, 5);
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, mapped_page_sized_file)
+{
+    // Fills a page exactly, so there is no room for a trailing
+    // terminator inside of the mapping.
+    char contents[4096];
+    const char header[] = "[section]\nkey=";
+    memcpy(contents, header, sizeof(header) - 1);
+    memset(contents + sizeof(header) - 1, 'v', sizeof(contents) - sizeof(header) + 1);
+
+    char path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(path, contents, sizeof(contents));
+    INIData_t *data = ini_parse_mapped(path);
+    remove(path);
+
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_EQ(strlen(ini_get_value(data, "section", "key")), sizeof(contents) - sizeof(header) + 1);
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, mapped_parse_error)
+{
+    const char contents[] = "[Section]\n"
+                            "[Section]\n";
+
+    char path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(path, contents, sizeof(contents) - 1);
+    INIData_t *data = ini_parse_mapped(path);
+    remove(path);
+
+    ASSERT_TRUE(data != NULL);
+    ASSERT_EQ(data->section_count, 0);
+    ASSERT_TRUE(data->error.encountered);
+    ASSERT_STREQ(data->error.line, "[Section]\n");
+    ASSERT_STREQ(data->error.msg, "Duplicate section 'Section'.");
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, indexed_lookups)
+{
+    FILE *file = tmpfile();
+    assert(file);
+    for (int i = 0; i < 40; i++)
+    {
+        fprintf(file, "[section%d]\n", i);
+        for (int j = 0; j < 40; j++)
+            fprintf(file, "key%d=value%d_%d\n", j, i, j);
+    }
+    fputs("key0=duplicate\n", file);
+    rewind(file);
+
+    INIData_t *data = ini_parse_file(file);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_TRUE(data->section_index != NULL);
+    ASSERT_TRUE(ini_section_at(data, 0)->index != NULL);
+
+    char section[32], key[32], value[32];
+    for (int i = 0; i < 40; i++)
+        for (int j = 0; j < 40; j++)
+        {
+            snprintf(section, sizeof(section), "section%d", i);
+            snprintf(key, sizeof(key), "key%d", j);
+            snprintf(value, sizeof(value), "value%d_%d", i, j);
+            ASSERT_STREQ(ini_get_value(data, section, key), value);
+        }
+    ASSERT_TRUE(ini_get_value(data, "section0", "key40") == NULL);
+    ASSERT_TRUE(ini_has_section(data, "section40") == NULL);
+
+    // The first of two pairs with the same key wins.
+    ASSERT_STREQ(ini_get_value(data, "section39", "key0"), "value39_0");
+
+    // The index keeps up with sections and pairs added after parsing.
+    INIPair_t pair = {"added", "yes"};
+    ASSERT_TRUE(ini_add_section(data, "section40") != NULL);
+    ASSERT_TRUE(ini_add_section(data, "section40") == NULL);
+    ASSERT_TRUE(ini_add_pair(data, "section40", pair) != NULL);
+    ASSERT_TRUE(ini_add_pair(data, "section3", pair) != NULL);
+    ASSERT_STREQ(ini_get_value(data, "section40", "added"), "yes");
+    ASSERT_STREQ(ini_get_value(data, "section3", "added"), "yes");
+
+    ini_free(data);
+    fclose(file);
+}
+
+
+
+TEST(ini_tests, arena_parsing)
+{
+    const char contents[] = "[section]\n"
+                            "hello=world\n"
+                            "[other]\n"
+                            "val=5\n";
+
+    static char memory[16384];
+    arena_t arena;
+    arena_init(&arena, memory, sizeof(memory));
+
+    FILE *file = tmpfile();
+    assert(file);
+    fputs(contents, file);
+    rewind(file);
+    INIData_t *data = ini_parse_file_arena(file, &arena);
+    fclose(file);
+
+    ASSERT_TRUE(data != NULL);
+    ASSERT_TRUE(data->arena == &arena);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_TRUE((char *)data >= memory && (char *)data < memory + sizeof(memory));
+    ASSERT_TRUE(ini_pair_at(ini_section_at(data, 1), 0)->value >= memory);
+    ASSERT_TRUE(ini_pair_at(ini_section_at(data, 1), 0)->value < memory + sizeof(memory));
+    ASSERT_STREQ(ini_get_value(data, "section", "hello"), "world");
+    ASSERT_STREQ(ini_get_value(data, "other", "val"), "5");
+
+    ini_free(data);
+    arena_clear(&arena);
+    ASSERT_EQ(arena_occupied(&arena), 0);
+}
+
+
+
+TEST(ini_tests, arena_exhausted)
+{
+    FILE *file = tmpfile();
+    assert(file);
+    for (int i = 0; i < 20; i++)
+        fprintf(file, "[section%d]\nkey=value%d\n", i, i);
+    rewind(file);
+
+    static char memory[16384];
+    arena_t arena;
+    arena_init(&arena, memory, sizeof(memory));
+    INIData_t *data = ini_parse_file_arena(file, &arena);
+    fclose(file);
+
+    // The parse moved to the heap and gave the arena back.
+    ASSERT_TRUE(data != NULL);
+    ASSERT_TRUE(data->arena == NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_EQ(arena_occupied(&arena), 0);
+    ASSERT_EQ(data->section_count, 20);
+    ASSERT_STREQ(ini_get_value(data, "section0", "key"), "value0");
+    ASSERT_STREQ(ini_get_value(data, "section19", "key"), "value19");
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, long_line_scanning)
+{
+    // Lines long enough for the vectorized scanners must be classified
+    // exactly like the short lines handled byte by byte. Padding is added
+    // on both sides of the character under test.
+    const char padding[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+    const ptrdiff_t shift = sizeof(padding) - 1;
+    const struct {
+        const char *short_format;
+        const char *long_format;
+        ptrdiff_t position;
+        bool section;
+    } cases[] = {
+        {"key=a%cb", "key=%sa%cb%s", 5, false},
+        {"key=\"a%cb\"", "key=\"%sa%cb%s\"", 6, false},
+        {"k%cy=value", "k%s%cy%s=value", 1, false},
+        {"[s%ct]", "[s%s%ct%s]", 2, true},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        for (int c = 1; c < 256; c++)
+        {
+            char short_line[64];
+            char long_line[192];
+            snprintf(short_line, sizeof(short_line), cases[i].short_format, c);
+            snprintf(long_line, sizeof(long_line), cases[i].long_format, padding, c, padding);
+
+            bool short_result, long_result;
+            ptrdiff_t short_offset, long_offset;
+            if (cases[i].section)
+            {
+                INISection_t section;
+                short_result = ini_parse_section(short_line, NULL, &short_offset);
+                long_result = ini_parse_section(long_line, &section, &long_offset);
+            }
+            else
+            {
+                INIPair_t pair;
+                short_result = ini_parse_pair(short_line, NULL, &short_offset);
+                long_result = ini_parse_pair(long_line, &pair, &long_offset);
+            }
+
+            ptrdiff_t expected_offset = short_offset;
+            if (short_offset > cases[i].position + 1) expected_offset += 2 * shift;
+            else if (short_offset > 0) expected_offset += shift;
+
+            ASSERT_EQ(short_result, long_result);
+            ASSERT_EQ(expected_offset, long_offset);
+        }
+    }
+}
+
+
+
+typedef struct
+{
+    char log[512];
+    int pairs;
+    int stop_after;
+} EventLog_t;
+
+
+
+static bool log_section_(void *user, INIView_t name)
+{
+    EventLog_t *log = user;
+    const size_t length = strlen(log->log);
+    snprintf(log->log + length, sizeof(log->log) - length, "[%.*s]", (int)name.length, name.ptr);
+    return true;
+}
+
+
+
+static bool log_pair_(void *user, INIView_t section, INIView_t key, INIView_t value)
+{
+    EventLog_t *log = user;
+    const size_t length = strlen(log->log);
+    snprintf(log->log + length, sizeof(log->log) - length, "%.*s.%.*s=%.*s;",
+             (int)section.length, section.ptr, (int)key.length, key.ptr, (int)value.length, value.ptr);
+    return ++log->pairs != log->stop_after;
+}
+
+
+
+static void log_error_(void *user, INIView_t line, ptrdiff_t offset, const char *msg)
+{
+    (void)line;
+    EventLog_t *log = user;
+    const size_t length = strlen(log->log);
+    snprintf(log->log + length, sizeof(log->log) - length, "!%td:%s", offset, msg);
+}
+
+
+
+TEST(ini_tests, event_parsing)
+{
+    const char contents[] = "[section]\n"
+                            "hello = world ; comment\n"
+                            "\n"
+                            "[other]\n"
+                            "this_one=\"is a string\"\n"
+                            "val=5\n";
+
+    const INIHandler_t handler = {log_section_, log_pair_, log_error_};
+    FILE *file = tmpfile();
+    assert(file);
+    fputs(contents, file);
+
+    EventLog_t log = {"", 0, 0};
+    rewind(file);
+    ASSERT_TRUE(ini_parse_events(file, &handler, &log));
+    ASSERT_STREQ(log.log, "[section]section.hello=world;[other]other.this_one=\"is a string\";other.val=5;");
+
+    // Stop as soon as the second pair has been seen.
+    EventLog_t partial = {"", 0, 2};
+    rewind(file);
+    ASSERT_FALSE(ini_parse_events(file, &handler, &partial));
+    ASSERT_STREQ(partial.log, "[section]section.hello=world;[other]other.this_one=\"is a string\";");
+    fclose(file);
+}
+
+
+
+TEST(ini_tests, event_parse_error)
+{
+    const char contents[] = "[ValidSection]\n"
+                            "good=pair\n"
+                            "bad=pa$ir\n"
+                            "never=seen\n";
+
+    const INIHandler_t handler = {NULL, log_pair_, log_error_};
+    FILE *file = tmpfile();
+    assert(file);
+    fputs(contents, file);
+    rewind(file);
+
+    EventLog_t log = {"", 0, 0};
+    ASSERT_FALSE(ini_parse_events(file, &handler, &log));
+    ASSERT_STREQ(log.log, "ValidSection.good=pair;!6:Failed to parse pair.");
+    fclose(file);
+}
+
+
+
+TEST(ini_tests, buffer_parsing)
+{
+    const char contents[] = "[section]\n"
+                            "hello=world\n"
+                            "  ; comment\n"
+                            "[other]\n"
+                            "this_one=\"is a string\"\n"
+                            "val=5\n"
+                            "[ignored]";
+
+    // Only pass the bytes up to "[ignored]"; nothing is null-terminated.
+    const size_t length = strstr(contents, "[ignored]") - contents;
+    INIData_t *data = ini_parse_buffer(contents, length - 1);
+
+    FILE *file = tmpfile();
+    assert(file);
+    fwrite(contents, 1, length - 1, file);
+    rewind(file);
+    INIData_t *file_data = ini_parse_file(file);
+    fclose(file);
+
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_EQ(data->section_count, file_data->section_count);
+    for (size_t i = 0; i < data->section_count; i++)
+    {
+        const INISection_t *section = ini_section_at(data, i);
+        const INISection_t *file_section = ini_section_at(file_data, i);
+        ASSERT_STREQ(section->name, file_section->name);
+        ASSERT_EQ(section->pair_count, file_section->pair_count);
+        for (size_t j = 0; j < section->pair_count; j++)
+        {
+            ASSERT_STREQ(ini_pair_at(section, j)->key, ini_pair_at(file_section, j)->key);
+            ASSERT_STREQ(ini_pair_at(section, j)->value, ini_pair_at(file_section, j)->value);
+        }
+    }
+    ASSERT_STREQ(ini_get_value(data, "other", "val"), "5");
+    ASSERT_TRUE(ini_has_section(data, "ignored") == NULL);
+
+    ini_free(data);
+    ini_free(file_data);
+}
+
+
+
+TEST(ini_tests, buffer_long_lines)
+{
+    static char contents[4096];
+    char *c = contents;
+    c += sprintf(c, "[section]\nkey=");
+    memset(c, 'v', 3000);
+    c += 3000;
+    *c++ = '\n';
+
+    INIData_t *data = ini_parse_buffer(contents, c - contents);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_EQ(strlen(ini_get_value(data, "section", "key")), 3000);
+    ini_free(data);
+}
+
+
+
+// Records the length of the section of a pair if it matches the name `user` points to.
+static bool match_section_(void *user, INIView_t section, INIView_t key, INIView_t value)
+{
+    (void)key;
+    (void)value;
+    INIView_t *expected = user;
+    if (strlen(expected->ptr) == section.length && memcmp(expected->ptr, section.ptr, section.length) == 0)
+        expected->length = section.length;
+    return true;
+}
+
+
+
+TEST(ini_tests, long_section_names)
+{
+    static char name[2000];
+    static char contents[4096];
+    memset(name, 's', sizeof(name) - 1);
+    const int length = snprintf(contents, sizeof(contents), "[%s]\nkey=value\n", name);
+
+    INIData_t *data = ini_parse_buffer(contents, length);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    const INISection_t *section = ini_has_section(data, name);
+    ASSERT_TRUE(section != NULL);
+    ASSERT_EQ(section->name_length, sizeof(name) - 1);
+    ASSERT_STREQ(ini_get_value(data, name, "key"), "value");
+
+    char *written = ini_write_string(data, NULL);
+    ASSERT_TRUE(written != NULL);
+    ASSERT_STREQ(written, contents);
+    free(written);
+    ini_free(data);
+
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    fputs(contents, file);
+    rewind(file);
+    data = ini_parse_file(file);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_STREQ(ini_get_value(data, name, "key"), "value");
+    ini_free(data);
+
+    rewind(file);
+    INIView_t seen = {name, 0};
+    const INIHandler_t handler = {NULL, match_section_, NULL};
+    ASSERT_TRUE(ini_parse_events(file, &handler, &seen));
+    ASSERT_EQ(seen.length, sizeof(name) - 1);
+    fclose(file);
+
+    data = ini_parse_buffer("", 0);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_TRUE(ini_add_section(data, name) != NULL);
+    ASSERT_TRUE(ini_add_section(data, name) == NULL);
+    ASSERT_EQ(ini_section_at(data, 0)->name_length, sizeof(name) - 1);
+    ini_free(data);
+
+    INISection_t parsed;
+    contents[sizeof(name) + 1] = '\0';
+    ASSERT_TRUE(ini_parse_section(contents, &parsed, NULL));
+    ASSERT_EQ(parsed.name_length, sizeof(name) - 1);
+}
+
+
+
+TEST(ini_tests, buffer_parse_error)
+{
+    const char contents[] = "[ValidSection]\n"
+                            "bad=pa$ir\n";
+
+    INIData_t *data = ini_parse_buffer(contents, sizeof(contents) - 1);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_EQ(data->section_count, 0);
+    ASSERT_TRUE(data->error.encountered);
+    ASSERT_STREQ(data->error.line, "bad=pa$ir\n");
+    ASSERT_STREQ(data->error.msg, "Failed to parse pair.");
+    ASSERT_EQ(data->error.offset, 6);
+    ini_free(data);
+
+    const INIHandler_t handler = {log_section_, log_pair_, log_error_};
+    EventLog_t log = {"", 0, 0};
+    ASSERT_FALSE(ini_parse_events_buffer(contents, sizeof(contents) - 1, &handler, &log));
+    ASSERT_STREQ(log.log, "[ValidSection]!6:Failed to parse pair.");
+}
+
+
+
+TEST(ini_tests, snapshot_round_trip)
+{
+    const char contents[] = "[section]\n"
+                            "hello=world\n"
+                            "hello=again\n"
+                            "[other]\n"
+                            "this_one=\"is a string\"\n";
+
+    char source_path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(source_path, contents, sizeof(contents) - 1);
+    char snapshot_path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(snapshot_path, "", 0);
+
+    INIData_t *data = ini_parse_mapped(source_path);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_TRUE(ini_write_snapshot(data, snapshot_path, source_path));
+    ini_free(data);
+
+    INISnapshot_t *snapshot = ini_load_snapshot(snapshot_path, source_path);
+    ASSERT_TRUE(snapshot != NULL);
+    ASSERT_TRUE(ini_snapshot_has_section(snapshot, "section"));
+    ASSERT_TRUE(ini_snapshot_has_section(snapshot, "other"));
+    ASSERT_FALSE(ini_snapshot_has_section(snapshot, "missing"));
+    ASSERT_STREQ(ini_snapshot_get_value(snapshot, "section", "hello"), "world");
+    ASSERT_STREQ(ini_snapshot_get_value(snapshot, "other", "this_one"), "\"is a string\"");
+    ASSERT_TRUE(ini_snapshot_get_value(snapshot, "other", "hello") == NULL);
+    ini_snapshot_free(snapshot);
+
+    remove(source_path);
+    remove(snapshot_path);
+}
+
+
+
+TEST(ini_tests, snapshot_stale_or_damaged)
+{
+    char source_path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(source_path, "[section]\nkey=old\n", 18);
+    char snapshot_path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(snapshot_path, "", 0);
+
+    INIData_t *data = ini_parse_mapped(source_path);
+    ASSERT_TRUE(ini_write_snapshot(data, snapshot_path, source_path));
+    ini_free(data);
+
+    // The source changed after the snapshot was taken.
+    FILE *source = fopen(source_path, "w");
+    fputs("[section]\nkey=newer\n", source);
+    fclose(source);
+
+    INISnapshot_t *snapshot = ini_load_snapshot(snapshot_path, source_path);
+    ASSERT_TRUE(snapshot != NULL);
+    ASSERT_STREQ(ini_snapshot_get_value(snapshot, "section", "key"), "newer");
+    ini_snapshot_free(snapshot);
+
+    // The stale snapshot was rewritten; damage it and make sure that is noticed too.
+    FILE *image = fopen(snapshot_path, "r+b");
+    ASSERT_TRUE(image != NULL);
+    fseek(image, -4, SEEK_END);
+    fputc('X', image);
+    fclose(image);
+
+    snapshot = ini_load_snapshot(snapshot_path, source_path);
+    ASSERT_TRUE(snapshot != NULL);
+    ASSERT_STREQ(ini_snapshot_get_value(snapshot, "section", "key"), "newer");
+    ini_snapshot_free(snapshot);
+
+    remove(source_path);
+    remove(snapshot_path);
+}
+
+
+
+TEST(ini_tests, frozen_lookups)
+{
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    for (int i = 0; i < 30; i++)
+    {
+        fprintf(file, "[section%d]\n", i);
+        for (int j = 0; j < 50; j++)
+            fprintf(file, "key%d=value%d_%d\n", j, i, j);
+    }
+    fputs("key0=duplicate\n", file);
+    fputs("[empty]\n", file);
+    rewind(file);
+
+    INIData_t *data = ini_parse_file(file);
+    fclose(file);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+
+    INISnapshot_t *frozen = ini_freeze(data);
+    ini_free(data);
+    ASSERT_TRUE(frozen != NULL);
+
+    char section[32], key[32], value[32];
+    for (int i = 0; i < 30; i++)
+    {
+        snprintf(section, sizeof(section), "section%d", i);
+        ASSERT_TRUE(ini_snapshot_has_section(frozen, section));
+        for (int j = 0; j < 50; j++)
+        {
+            snprintf(key, sizeof(key), "key%d", j);
+            snprintf(value, sizeof(value), "value%d_%d", i, j);
+            ASSERT_STREQ(ini_snapshot_get_value(frozen, section, key), value);
+        }
+    }
+    ASSERT_TRUE(ini_snapshot_has_section(frozen, "empty"));
+    ASSERT_FALSE(ini_snapshot_has_section(frozen, "section30"));
+    ASSERT_TRUE(ini_snapshot_get_value(frozen, "section0", "key50") == NULL);
+    ASSERT_TRUE(ini_snapshot_get_value(frozen, "empty", "key0") == NULL);
+    ASSERT_STREQ(ini_snapshot_get_value(frozen, "section29", "key0"), "value29_0");
+    ini_snapshot_free(frozen);
+
+    // A document with no pairs still freezes.
+    data = ini_parse_buffer("[only]\n", 7);
+    ASSERT_TRUE(data != NULL);
+    frozen = ini_freeze(data);
+    ini_free(data);
+    ASSERT_TRUE(frozen != NULL);
+    ASSERT_TRUE(ini_snapshot_has_section(frozen, "only"));
+    ASSERT_TRUE(ini_snapshot_get_value(frozen, "only", "key") == NULL);
+    ini_snapshot_free(frozen);
+}
+
+
+
+TEST(ini_tests, typed_accessors)
+{
+    const char contents[] = "[numbers]\n"
+                            "count=-42\n"
+                            "mask=0x1F\n"
+                            "ratio=0.25\n"
+                            "word=forty\n"
+                            "huge=99999999999999999999\n"
+                            "lowest=-9223372036854775808\n"
+                            "scientific=-1.5e3\n"
+                            "exponentless=2e\n"
+                            "[flags]\n"
+                            "a=TRUE\n"
+                            "b=off\n"
+                            "c=maybe\n"
+                            "[sizes]\n"
+                            "plain=512\n"
+                            "buffer=64k\n"
+                            "cache=2MB\n"
+                            "negative=-1k\n"
+                            "unknown=3q\n";
+
+    INIData_t *data = ini_parse_buffer(contents, sizeof(contents) - 1);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+
+    long long integer = 7;
+    ASSERT_TRUE(ini_get_int(data, "numbers", "count", &integer));
+    ASSERT_EQ(integer, -42);
+    ASSERT_TRUE(ini_get_int(data, "numbers", "mask", &integer));
+    ASSERT_EQ(integer, 31);
+    ASSERT_FALSE(ini_get_int(data, "numbers", "ratio", &integer));
+    ASSERT_FALSE(ini_get_int(data, "numbers", "word", &integer));
+    ASSERT_FALSE(ini_get_int(data, "numbers", "huge", &integer));
+    ASSERT_FALSE(ini_get_int(data, "numbers", "missing", &integer));
+    ASSERT_EQ(integer, 31);
+
+    double real = 0;
+    ASSERT_TRUE(ini_get_double(data, "numbers", "ratio", &real));
+    ASSERT_TRUE(real == 0.25);
+    ASSERT_TRUE(ini_get_double(data, "numbers", "count", &real));
+    ASSERT_TRUE(real == -42.0);
+    ASSERT_FALSE(ini_get_double(data, "numbers", "word", &real));
+    ASSERT_TRUE(ini_get_double(data, "numbers", "scientific", &real));
+    ASSERT_TRUE(real == -1500.0);
+    ASSERT_FALSE(ini_get_double(data, "numbers", "exponentless", &real));
+    ASSERT_TRUE(ini_get_int(data, "numbers", "lowest", &integer));
+    ASSERT_TRUE(integer == LLONG_MIN);
+
+    // A locale with a decimal comma changes nothing, if one is installed.
+    const char *const comma_locales[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8"};
+    for (size_t i = 0; i < sizeof(comma_locales) / sizeof(*comma_locales); i++)
+    {
+        if (!setlocale(LC_NUMERIC, comma_locales[i])) continue;
+        ASSERT_TRUE(ini_set_value(data, "numbers", "ratio", "0.5") != NULL);
+        const bool converted = ini_get_double(data, "numbers", "ratio", &real);
+        setlocale(LC_NUMERIC, "C");
+        ASSERT_TRUE(converted);
+        ASSERT_TRUE(real == 0.5);
+        break;
+    }
+
+    bool boolean = false;
+    ASSERT_TRUE(ini_get_bool(data, "flags", "a", &boolean));
+    ASSERT_TRUE(boolean);
+    ASSERT_TRUE(ini_get_bool(data, "flags", "b", &boolean));
+    ASSERT_FALSE(boolean);
+    ASSERT_FALSE(ini_get_bool(data, "flags", "c", &boolean));
+
+    size_t size = 0;
+    ASSERT_TRUE(ini_get_size(data, "sizes", "plain", &size));
+    ASSERT_TRUE(size == 512);
+    ASSERT_TRUE(ini_get_size(data, "sizes", "buffer", &size));
+    ASSERT_TRUE(size == 64 * 1024);
+    ASSERT_TRUE(ini_get_size(data, "sizes", "cache", &size));
+    ASSERT_TRUE(size == 2 * 1024 * 1024);
+    ASSERT_FALSE(ini_get_size(data, "sizes", "negative", &size));
+    ASSERT_FALSE(ini_get_size(data, "sizes", "unknown", &size));
+
+    // Repeated reads come from the cache, and setting a value resets it.
+    const INIEntry_t *entry = ini_set_value(data, "numbers", "count", "-42");
+    ASSERT_TRUE(entry != NULL);
+    ASSERT_TRUE(ini_get_int(data, "numbers", "count", &integer));
+    ASSERT_TRUE(ini_get_int(data, "numbers", "count", &integer));
+    ASSERT_TRUE(entry->cache.valid);
+    ASSERT_TRUE(ini_set_value(data, "numbers", "count", "1000") == entry);
+    ASSERT_TRUE(ini_get_int(data, "numbers", "count", &integer));
+    ASSERT_EQ(integer, 1000);
+    ASSERT_STREQ(ini_get_value(data, "numbers", "count"), "1000");
+    ASSERT_TRUE(ini_set_value(data, "flags", "c", "yes") != NULL);
+    ASSERT_TRUE(ini_get_bool(data, "flags", "c", &boolean));
+    ASSERT_TRUE(boolean);
+    ASSERT_TRUE(ini_set_value(data, "flags", "missing", "yes") == NULL);
+
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, handle_lookups)
+{
+    const char contents[] = "[section]\n"
+                            "hello=world\n"
+                            "[other]\n"
+                            "key=value\n";
+
+    INIData_t *data = ini_parse_buffer(contents, sizeof(contents) - 1);
+    ASSERT_TRUE(data != NULL);
+
+    const INIHandle_t hello = ini_resolve(data, "section", "hello");
+    const INIHandle_t key = ini_resolve(data, "other", "key");
+    const INIHandle_t missing = ini_resolve(data, "other", "hello");
+    ASSERT_STREQ(ini_get_by_handle(data, hello), "world");
+    ASSERT_STREQ(ini_get_by_handle(data, key), "value");
+    ASSERT_EQ(missing.generation, 0);
+    ASSERT_TRUE(ini_get_by_handle(data, missing) == NULL);
+
+    // Changing a value keeps the handle valid.
+    ASSERT_TRUE(ini_set_value(data, "section", "hello", "again") != NULL);
+    ASSERT_STREQ(ini_get_by_handle(data, hello), "again");
+
+    // Adding to the document does not.
+    const INIPair_t pair = {"added", "yes"};
+    ASSERT_TRUE(ini_add_pair(data, "other", pair) != NULL);
+    ASSERT_TRUE(ini_get_by_handle(data, hello) == NULL);
+    ASSERT_TRUE(ini_get_by_handle(data, key) == NULL);
+    ASSERT_STREQ(ini_get_by_handle(data, ini_resolve(data, "other", "added")), "yes");
+
+    INIHandle_t forged = ini_resolve(data, "other", "key");
+    forged.pair = 10;
+    ASSERT_TRUE(ini_get_by_handle(data, forged) == NULL);
+
+    ini_free(data);
+}
+
+
+
+static void log_section_change_(void *user, const INISection_t *old_section, const INISection_t *new_section)
+{
+    EventLog_t *log = user;
+    const size_t length = strlen(log->log);
+    const char change = !old_section ? '+' : !new_section ? '-' : '~';
+    snprintf(log->log + length, sizeof(log->log) - length, "%c[%s]", change,
+             new_section ? new_section->name : old_section->name);
+}
+
+
+
+static void log_pair_change_(void *user, const char *section, const INIEntry_t *old_pair, const INIEntry_t *new_pair)
+{
+    EventLog_t *log = user;
+    const size_t length = strlen(log->log);
+    snprintf(log->log + length, sizeof(log->log) - length, "%s.%s:%s>%s;", section,
+             new_pair ? new_pair->key : old_pair->key, old_pair ? old_pair->value : "", new_pair ? new_pair->value : "");
+}
+
+
+
+TEST(ini_tests, apply_update)
+{
+    const char before[] = "[same]\n"
+                          "a=1\n"
+                          "[changed]\n"
+                          "kept=yes\n"
+                          "edited=old\n"
+                          "dropped=x\n"
+                          "[removed]\n"
+                          "k=v\n";
+    const char after[] = "[changed]\n"
+                         "kept=yes\n"
+                         "edited=new\n"
+                         "added=y\n"
+                         "[same]\n"
+                         "a=1\n"
+                         "[new]\n"
+                         "n=1\n";
+
+    INIData_t *data = ini_parse_buffer(before, sizeof(before) - 1);
+    ASSERT_TRUE(data != NULL);
+    const INIEntry_t *same_pairs = ini_pair_at(ini_has_section(data, "same"), 0);
+    const INIHandle_t handle = ini_resolve(data, "same", "a");
+
+    INIData_t *update = ini_parse_buffer(after, sizeof(after) - 1);
+    ASSERT_TRUE(update != NULL);
+    const INIDiffHandler_t handler = {log_section_change_, log_pair_change_, NULL};
+    EventLog_t log = {"", 0, 0};
+    ASSERT_TRUE(ini_apply(data, update, &handler, &log));
+    ASSERT_STREQ(log.log, "~[changed]changed.edited:old>new;changed.added:>y;changed.dropped:x>;"
+                          "+[new]new.n:>1;"
+                          "-[removed]removed.k:v>;");
+
+    // The unchanged section kept its storage, but handles are out of date.
+    ASSERT_TRUE(ini_pair_at(ini_has_section(data, "same"), 0) == same_pairs);
+    ASSERT_TRUE(ini_get_by_handle(data, handle) == NULL);
+    ASSERT_EQ(data->section_count, 3);
+    ASSERT_STREQ(ini_get_value(data, "changed", "edited"), "new");
+    ASSERT_STREQ(ini_get_value(data, "new", "n"), "1");
+    ASSERT_TRUE(ini_has_section(data, "removed") == NULL);
+
+    ini_free(data);
+}
+
+
+
+#if defined(__linux__)
+TEST(ini_tests, watch_reload)
+{
+    char path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(path, "[section]\nkey=old\n[other]\nkey=same\n", 35);
+
+    const INIDiffHandler_t handler = {log_section_change_, log_pair_change_, log_error_};
+    EventLog_t log = {"", 0, 0};
+    INIWatcher_t *watcher = ini_watch(path, &handler, &log);
+    ASSERT_TRUE(watcher != NULL);
+    INIData_t *data = ini_watch_data(watcher);
+    ASSERT_STREQ(ini_get_value(data, "section", "key"), "old");
+    ASSERT_FALSE(ini_watch_poll(watcher, 0));
+
+    // Written in place.
+    FILE *file = fopen(path, "w");
+    fputs("[section]\nkey=new\n[other]\nkey=same\n", file);
+    fclose(file);
+    ASSERT_TRUE(ini_watch_poll(watcher, 1000));
+    ASSERT_TRUE(ini_watch_data(watcher) == data);
+    ASSERT_STREQ(ini_get_value(data, "section", "key"), "new");
+    ASSERT_STREQ(log.log, "~[section]section.key:old>new;");
+
+    // Replaced by a broken file, then by a good one.
+    char replacement[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(replacement, "key=orphan\n", 11);
+    ASSERT_EQ(rename(replacement, path), 0);
+    log.log[0] = '\0';
+    ASSERT_FALSE(ini_watch_poll(watcher, 1000));
+    ASSERT_STREQ(log.log, "!0:" "Pairs must reside within a section.");
+    ASSERT_STREQ(ini_get_value(data, "section", "key"), "new");
+
+    char fixed[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(fixed, "[other]\nkey=same\n", 17);
+    ASSERT_EQ(rename(fixed, path), 0);
+    log.log[0] = '\0';
+    ASSERT_TRUE(ini_watch_poll(watcher, 1000));
+    ASSERT_STREQ(log.log, "-[section]section.key:new>;");
+
+    ini_watch_free(watcher);
+    remove(path);
+}
+#endif
+
+
+
+TEST(ini_tests, published_snapshots)
+{
+    INIData_t *first = ini_parse_buffer("[s]\nkey=1\n", 10);
+    INIData_t *second = ini_parse_buffer("[s]\nkey=2\n", 10);
+    INIData_t *third = ini_parse_buffer("[s]\nkey=3\n", 10);
+    ASSERT_TRUE(first && second && third);
+
+    INIPublisher_t *publisher = ini_publisher_create(first);
+    ASSERT_TRUE(publisher != NULL);
+    INIReader_t *slow = ini_reader_register(publisher);
+    INIReader_t *fast = ini_reader_register(publisher);
+    ASSERT_TRUE(slow != NULL && fast != NULL && slow != fast);
+
+    // A pinned document survives being replaced, twice.
+    const INIData_t *pinned = ini_read_begin(slow);
+    ASSERT_TRUE(pinned == first);
+    ASSERT_TRUE(ini_publish(publisher, second));
+    ASSERT_TRUE(ini_read_begin(fast) == second);
+    ini_read_end(fast);
+    ASSERT_TRUE(ini_publish(publisher, third));
+    ASSERT_STREQ(ini_get_value(pinned, "s", "key"), "1");
+    ini_read_end(slow);
+    ini_publisher_reclaim(publisher);
+
+    pinned = ini_read_begin(slow);
+    ASSERT_STREQ(ini_get_value(pinned, "s", "key"), "3");
+    ini_read_end(slow);
+
+    // Registrations are reused once given up.
+    ini_reader_unregister(fast);
+    ASSERT_TRUE(ini_reader_register(publisher) == fast);
+
+    ini_publisher_free(publisher);
+}
+
+
+
+TEST(ini_tests, long_values_and_emplace)
+{
+    static char long_value[3000];
+    memset(long_value, 'v', sizeof(long_value) - 1);
+
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    fprintf(file, "[section]\nlong=%s\nafter=1\n", long_value);
+    rewind(file);
+
+    INIData_t *data = ini_parse_file(file);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_STREQ(ini_get_value(data, "section", "long"), long_value);
+    ASSERT_STREQ(ini_get_value(data, "section", "after"), "1");
+
+    EventLog_t log = {"", 0, 0};
+    const INIHandler_t handler = {NULL, log_pair_, log_error_};
+    rewind(file);
+    ASSERT_TRUE(ini_parse_events(file, &handler, &log));
+    ASSERT_EQ(log.pairs, 2);
+    fclose(file);
+
+    const INIView_t key = {"emplaced", 8};
+    const INIView_t value = {long_value, sizeof(long_value) - 1};
+    const INIEntry_t *entry = ini_emplace_pair(data, "section", key, value);
+    ASSERT_TRUE(entry != NULL);
+    ASSERT_TRUE(entry->value_length == sizeof(long_value) - 1);
+    ASSERT_STREQ(ini_get_value(data, "section", "emplaced"), long_value);
+    ASSERT_TRUE(ini_emplace_pair(data, "missing", key, value) == NULL);
+
+    const INIView_t partial = {"abcdef", 3};
+    ASSERT_TRUE(ini_emplace_pair_to_section(ini_section_at(data, 0), partial, partial) != NULL);
+    ASSERT_STREQ(ini_get_value(data, "section", "abc"), "abc");
+
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, null_bytes)
+{
+    // Null bytes make a line fail to parse where they are, wherever they are in it.
+    const char starting[] = "[section]\n\0key=value\n";
+    const char embedded[] = "[section]\nkey=va\0lue\n";
+    const char *const contents[] = {starting, embedded};
+    const size_t lengths[] = {sizeof(starting) - 1, sizeof(embedded) - 1};
+    const ptrdiff_t offsets[] = {0, 6};
+    for (size_t i = 0; i < 2; i++)
+    {
+        FILE *file = tmpfile();
+        ASSERT_TRUE(file != NULL);
+        fwrite(contents[i], 1, lengths[i], file);
+        rewind(file);
+
+        INIData_t *data = ini_parse_file(file);
+        ASSERT_TRUE(data != NULL);
+        ASSERT_TRUE(data->error.encountered);
+        ASSERT_STREQ(data->error.msg, "Failed to parse pair.");
+        ASSERT_EQ(data->error.offset, offsets[i]);
+        ini_free(data);
+
+        EventLog_t log = {"", 0, 0};
+        const INIHandler_t handler = {log_section_, log_pair_, log_error_};
+        rewind(file);
+        ASSERT_FALSE(ini_parse_events(file, &handler, &log));
+        ASSERT_EQ(log.pairs, 0);
+        fclose(file);
+    }
+}
+
+
+
+TEST(ini_tests, key_hash_scan)
+{
+    // Fewer pairs than it takes to build an index, but enough to fill several vectors of hashes.
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    fputs("[section]\n", file);
+    for (int i = 0; i < 20; i++)
+        fprintf(file, "key%d=value%d\n", i, i);
+    fputs("key19=duplicate\n", file);
+    rewind(file);
+
+    INIData_t *data = ini_parse_file(file);
+    fclose(file);
+    ASSERT_TRUE(data != NULL);
+    const INISection_t *section = ini_has_section(data, "section");
+    ASSERT_TRUE(section->index == NULL);
+    ASSERT_EQ(section->pair_count, 21);
+
+    char key[32], value[32];
+    for (int i = 0; i < 20; i++)
+    {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        ASSERT_STREQ(ini_get_value(data, "section", key), value);
+    }
+    ASSERT_TRUE(ini_get_value(data, "section", "key20") == NULL);
+    ASSERT_TRUE(ini_get_value(data, "section", "") == NULL);
+
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, buffered_writing)
+{
+    const char contents[] = "[section]\n"
+                            "hello=world\n"
+                            "[other]\n"
+                            "this_one=\"is a string\"\n"
+                            "val=5\n";
+
+    INIData_t *data = ini_parse_buffer(contents, sizeof(contents) - 1);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_TRUE(ini_write_size(data) == sizeof(contents) - 1);
+
+    char small[8];
+    memset(small, 'x', sizeof(small));
+    ASSERT_TRUE(ini_write_buffer(data, small, sizeof(small)) == sizeof(contents) - 1);
+    ASSERT_EQ(small[0], 'x');
+
+    char exact[sizeof(contents) - 1];
+    ASSERT_TRUE(ini_write_buffer(data, exact, sizeof(exact)) == sizeof(exact));
+    ASSERT_TRUE(memcmp(exact, contents, sizeof(exact)) == 0);
+
+    size_t length;
+    char *string = ini_write_string(data, &length);
+    ASSERT_TRUE(string != NULL);
+    ASSERT_TRUE(length == sizeof(contents) - 1);
+    ASSERT_STREQ(string, contents);
+    free(string);
+
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    ASSERT_TRUE(ini_write_fd(data, fileno(file)));
+    char read_back[sizeof(contents)] = {0};
+    rewind(file);
+    ASSERT_TRUE(fread(read_back, 1, sizeof(read_back), file) == sizeof(contents) - 1);
+    ASSERT_STREQ(read_back, contents);
+    fclose(file);
+
+    // Failed writes are reported.
+    file = fopen("/dev/null", "r");
+    ASSERT_TRUE(file != NULL);
+    ASSERT_FALSE(ini_write_file(data, file));
+    fclose(file);
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, incremental_writer)
+{
+    INIWriter_t writer;
+    ini_writer_init(&writer, NULL);
+    const INIView_t section = {"section", 7};
+    const INIView_t key = {"key", 3};
+    const INIView_t value = {"value", 5};
+    ASSERT_TRUE(ini_writer_begin_section(&writer, section));
+    ASSERT_TRUE(ini_writer_pair(&writer, key, value));
+    ASSERT_TRUE(writer.length == 20);
+    ASSERT_TRUE(memcmp(writer.buffer, "[section]\nkey=value\n", 20) == 0);
+    ini_writer_free(&writer);
+
+    // Enough output to go through the buffer several times.
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    ini_writer_init(&writer, file);
+    ASSERT_TRUE(ini_writer_begin_section(&writer, section));
+    char key_buffer[32];
+    for (int i = 0; i < 20000; i++)
+    {
+        const INIView_t numbered = {key_buffer, (size_t)snprintf(key_buffer, sizeof(key_buffer), "key%d", i)};
+        ASSERT_TRUE(ini_writer_pair(&writer, numbered, value));
+    }
+    ASSERT_TRUE(ini_writer_flush(&writer));
+    ini_writer_free(&writer);
+
+    rewind(file);
+    INIData_t *data = ini_parse_file(file);
+    fclose(file);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_EQ(ini_section_at(data, 0)->pair_count, 20000);
+    ASSERT_STREQ(ini_get_value(data, "section", "key19999"), "value");
+    ini_free(data);
+}
+
+
+
+// Writes `sections` sections of `pairs` pairs each, enough for several parallel chunks.
+static char *generate_contents_(int sections, int pairs, size_t *length)
+{
+    INIWriter_t writer;
+    ini_writer_init(&writer, NULL);
+    char name[32], key[32], value[32];
+    for (int i = 0; i < sections; i++)
+    {
+        const INIView_t section = {name, (size_t)snprintf(name, sizeof(name), "section%d", i)};
+        ini_writer_begin_section(&writer, section);
+        for (int j = 0; j < pairs; j++)
+        {
+            const INIView_t k = {key, (size_t)snprintf(key, sizeof(key), "key%d", j)};
+            const INIView_t v = {value, (size_t)snprintf(value, sizeof(value), "value%d_%d", i, j)};
+            ini_writer_pair(&writer, k, v);
+        }
+    }
+    *length = writer.length;
+    return writer.buffer;
+}
+
+
+
+TEST(ini_tests, parallel_parsing)
+{
+    size_t length;
+    char *contents = generate_contents_(2000, 20, &length);
+    ASSERT_TRUE(contents != NULL);
+
+    INIData_t *serial = ini_parse_buffer(contents, length);
+    INIData_t *parallel = ini_parse_buffer_parallel(contents, length, 8);
+    ASSERT_TRUE(parallel != NULL);
+    ASSERT_FALSE(parallel->error.encountered);
+    ASSERT_EQ(parallel->section_count, 2000);
+    ASSERT_STREQ(ini_get_value(parallel, "section1999", "key19"), "value1999_19");
+    size_t expected_length, actual_length;
+    char *expected = ini_write_string(serial, &expected_length);
+    char *actual = ini_write_string(parallel, &actual_length);
+    ASSERT_EQ(actual_length, expected_length);
+    ASSERT_EQ(memcmp(actual, expected, expected_length), 0);
+    free(actual);
+    ini_free(parallel);
+
+    char path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(path, contents, length);
+    parallel = ini_parse_mapped_parallel(path, 0);
+    remove(path);
+    ASSERT_TRUE(parallel != NULL);
+    ASSERT_FALSE(parallel->error.encountered);
+    actual = ini_write_string(parallel, &actual_length);
+    ASSERT_EQ(actual_length, expected_length);
+    ASSERT_EQ(memcmp(actual, expected, expected_length), 0);
+    free(actual);
+    free(expected);
+    ini_free(parallel);
+    ini_free(serial);
+    free(contents);
+}
+
+
+
+TEST(ini_tests, parallel_parse_errors)
+{
+    size_t length;
+    char *contents = generate_contents_(2000, 20, &length);
+    ASSERT_TRUE(contents != NULL);
+
+    // A duplicate of a section that is certain to be in another chunk.
+    const char duplicate[] = "[section0]\n";
+    char *with_duplicate = malloc(length + sizeof(duplicate));
+    ASSERT_TRUE(with_duplicate != NULL);
+    memcpy(with_duplicate, contents, length);
+    memcpy(with_duplicate + length, duplicate, sizeof(duplicate));
+    INIData_t *data = ini_parse_buffer_parallel(with_duplicate, length + sizeof(duplicate) - 1, 8);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_TRUE(data->error.encountered);
+    ASSERT_STREQ(data->error.msg, "Duplicate section 'section0'.");
+    ASSERT_STREQ(data->error.line, "[section0]\n");
+    ASSERT_EQ(data->section_count, 0);
+    ini_free(data);
+
+    // Parsing in place leaves the duplicate behind other sections of its chunk that were already parsed.
+    const char trailer[] = "[extra]\nk=v\n[section0]\n";
+    char *mapped_contents = malloc(length + sizeof(trailer));
+    ASSERT_TRUE(mapped_contents != NULL);
+    memcpy(mapped_contents, contents, length);
+    memcpy(mapped_contents + length, trailer, sizeof(trailer));
+    char path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(path, mapped_contents, length + sizeof(trailer) - 1);
+    free(mapped_contents);
+    data = ini_parse_mapped_parallel(path, 8);
+    remove(path);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_TRUE(data->error.encountered);
+    ASSERT_STREQ(data->error.msg, "Duplicate section 'section0'.");
+    ASSERT_STREQ(data->error.line, "[section0]\n");
+    ASSERT_EQ(data->section_count, 0);
+    ini_free(data);
+
+    // An earlier error in a later chunk still comes first.
+    char *bad = strstr(with_duplicate, "[section1000]");
+    ASSERT_TRUE(bad != NULL);
+    bad = strchr(bad, '\n') + 1;
+    memcpy(bad, "key0 value", 10);
+    data = ini_parse_buffer_parallel(with_duplicate, length + sizeof(duplicate) - 1, 8);
+    INIData_t *serial = ini_parse_buffer(with_duplicate, length + sizeof(duplicate) - 1);
+    ASSERT_TRUE(data->error.encountered);
+    ASSERT_STREQ(data->error.msg, serial->error.msg);
+    ASSERT_STREQ(data->error.line, serial->error.line);
+    ASSERT_EQ(data->error.offset, serial->error.offset);
+    ini_free(serial);
+    ini_free(data);
+    free(with_duplicate);
+    free(contents);
+}
+
+
+
+TEST(ini_tests, lazy_sections)
+{
+    const char contents[] = "; leading comment\n"
+                            "[first]\n"
+                            "a = 1\n"
+                            "[broken]\n"
+                            "fine = yes\n"
+                            "bad=pa$ir\n"
+                            "  [last]\n"
+                            "b = two";
+
+    char path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(path, contents, sizeof(contents) - 1);
+    INIData_t *data = ini_parse_lazy(path);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_EQ(data->section_count, 3);
+    ASSERT_TRUE(data->section_blocks[0][0].pending != NULL);
+    ASSERT_EQ(data->section_blocks[0][0].pair_count, 0);
+
+    ASSERT_STREQ(ini_get_value(data, "last", "b"), "two");
+    ASSERT_TRUE(data->section_blocks[0][0].pending != NULL);
+    ASSERT_TRUE(data->section_blocks[0][1].pending != NULL);
+    ASSERT_STREQ(ini_get_value(data, "first", "a"), "1");
+    ASSERT_TRUE(data->section_blocks[0][0].pending == NULL);
+    ASSERT_FALSE(data->error.encountered);
+
+    // The error only shows once the broken section is looked at.
+    const INISection_t *broken = ini_has_section(data, "broken");
+    ASSERT_TRUE(broken != NULL);
+    ASSERT_EQ(broken->pair_count, 0);
+    ASSERT_TRUE(data->error.encountered);
+    ASSERT_STREQ(data->error.line, "bad=pa$ir\n");
+    ASSERT_STREQ(data->error.msg, "Failed to parse pair.");
+    ASSERT_EQ(data->error.offset, 6);
+    ASSERT_FALSE(ini_load_sections(data));
+    ASSERT_STREQ(ini_get_value(data, "first", "a"), "1");
+    ini_free(data);
+
+    // Problems outside of sections are found up front.
+    const char *const invalid[] = {"[a]\nx=1\n[b\n", "[a]\n[b]\n[a]\n", "x=1\n[a]\n"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); i++)
+    {
+        char invalid_path[] = "/tmp/ini_tests_XXXXXX";
+        write_temp_file_(invalid_path, invalid[i], strlen(invalid[i]));
+        data = ini_parse_lazy(invalid_path);
+        remove(invalid_path);
+        ASSERT_TRUE(data != NULL);
+        ASSERT_TRUE(data->error.encountered);
+        ASSERT_EQ(data->section_count, 0);
+        ini_free(data);
+    }
+
+    // Publishing parses every section, so that readers never write to the document.
+    data = ini_parse_lazy(path);
+    ASSERT_TRUE(data != NULL);
+    INIPublisher_t *publisher = ini_publisher_create(data);
+    ASSERT_TRUE(publisher != NULL);
+    ASSERT_TRUE(data->section_blocks[0][0].pending == NULL);
+    ASSERT_TRUE(data->section_blocks[0][2].pending == NULL);
+    data = ini_parse_lazy(path);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_TRUE(ini_publish(publisher, data));
+    ASSERT_TRUE(data->section_blocks[0][1].pending == NULL);
+    ini_publisher_free(publisher);
+
+    data = ini_parse_lazy(path);
+    remove(path);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(ini_load_sections(data));
+    ASSERT_STREQ(data->error.line, "bad=pa$ir\n");
+    ASSERT_STREQ(ini_get_value(data, "last", "b"), "two");
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, batched_lookups)
+{
+    const char contents[] = "[server]\n"
+                            "host = localhost\n"
+                            "port = 8080\n"
+                            "[client]\n"
+                            "retries = 3\n";
+
+    INIData_t *data = ini_parse_buffer(contents, sizeof(contents) - 1);
+    ASSERT_TRUE(data != NULL);
+    const INIQuery_t queries[] = {
+        {"server", "host"},
+        {"server", "port"},
+        {"server", "missing"},
+        {"client", "retries"},
+        {"missing", "host"},
+        {"server", "host"},
+        {NULL, "host"},
+    };
+    const char *values[sizeof(queries) / sizeof(*queries)];
+    ASSERT_EQ(ini_get_values(data, queries, sizeof(queries) / sizeof(*queries), values), 4);
+    ASSERT_STREQ(values[0], "localhost");
+    ASSERT_STREQ(values[1], "8080");
+    ASSERT_TRUE(values[2] == NULL);
+    ASSERT_STREQ(values[3], "3");
+    ASSERT_TRUE(values[4] == NULL);
+    ASSERT_STREQ(values[5], "localhost");
+    ASSERT_TRUE(values[6] == NULL);
+
+    INIQuery_t interleaved[100];
+    const char *interleaved_values[100];
+    for (size_t i = 0; i < 100; i++)
+        interleaved[i] = i % 2 ? (INIQuery_t){"client", "retries"} : (INIQuery_t){"server", "port"};
+    ASSERT_EQ(ini_get_values(data, interleaved, 100, interleaved_values), 100);
+    for (size_t i = 0; i < 100; i++)
+        ASSERT_STREQ(interleaved_values[i], i % 2 ? "3" : "8080");
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, ordered_iteration)
+{
+    const char contents[] = "[pool]\n"
+                            "pool_db_min_conns = 1\n"
+                            "pool_cache_size = 64\n"
+                            "pool_db_max_conns = 8\n"
+                            "pool_dbx = other\n"
+                            "pool_db_timeouts_connect = 5\n"
+                            "pool = on\n";
+
+    INIData_t *data = ini_parse_buffer(contents, sizeof(contents) - 1);
+    ASSERT_TRUE(data != NULL);
+    INISection_t *section = ini_has_section(data, "pool");
+    ASSERT_TRUE(section != NULL);
+
+    char keys[256] = "";
+    INIIterator_t iter;
+    ASSERT_TRUE(ini_iter_prefix(section, "pool_db_", &iter));
+    for (const INIEntry_t *entry = ini_iter_next(&iter); entry; entry = ini_iter_next(&iter))
+    {
+        strcat(keys, entry->key);
+        strcat(keys, " ");
+    }
+    ASSERT_STREQ(keys, "pool_db_max_conns pool_db_min_conns pool_db_timeouts_connect ");
+
+    keys[0] = '\0';
+    ASSERT_TRUE(ini_iter_range(section, "pool_cache", "pool_db_min", &iter));
+    for (const INIEntry_t *entry = ini_iter_next(&iter); entry; entry = ini_iter_next(&iter))
+    {
+        strcat(keys, entry->key);
+        strcat(keys, " ");
+    }
+    ASSERT_STREQ(keys, "pool_cache_size pool_db_max_conns ");
+
+    ASSERT_TRUE(ini_iter_range(section, NULL, NULL, &iter));
+    ASSERT_STREQ(ini_iter_next(&iter)->key, "pool");
+    ASSERT_TRUE(ini_iter_prefix(section, "pool_zzz", &iter));
+    ASSERT_TRUE(ini_iter_next(&iter) == NULL);
+
+    // Added pairs end the iteration and are found by the next one.
+    ASSERT_TRUE(ini_iter_prefix(section, "pool_db", &iter));
+    const INIPair_t pair = {"pool_db_alias", "main"};
+    ASSERT_TRUE(ini_add_pair(data, "pool", pair) != NULL);
+    ASSERT_TRUE(ini_iter_next(&iter) == NULL);
+    ASSERT_TRUE(ini_iter_prefix(section, "pool_db", &iter));
+    ASSERT_STREQ(ini_iter_next(&iter)->key, "pool_db_alias");
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, mapped_empty_values)
+{
+    // Terminating an empty value in place must not touch the next line.
+    const char contents[] = "[section]\n"
+                            "empty=\n"
+                            "next=1\n"
+                            "commented= ; nothing\n"
+                            "last=2\n"
+                            "end=";
+
+    char path[] = "/tmp/ini_tests_XXXXXX";
+    write_temp_file_(path, contents, sizeof(contents) - 1);
+    INIData_t *data = ini_parse_mapped(path);
+    remove(path);
+
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_STREQ(ini_get_value(data, "section", "empty"), "");
+    ASSERT_STREQ(ini_get_value(data, "section", "next"), "1");
+    ASSERT_STREQ(ini_get_value(data, "section", "commented"), "");
+    ASSERT_STREQ(ini_get_value(data, "section", "last"), "2");
+    ASSERT_STREQ(ini_get_value(data, "section", "end"), "");
+    ini_free(data);
+}
+
+
+
+typedef struct
+{
+    const char *host;
+    long long port;
+    double ratio;
+    bool verbose;
+    size_t buffer;
+    long long retries;
+} ServerConfig_t;
+
+
+
+TEST(ini_tests, struct_binding)
+{
+    const char contents[] = "[server]\n"
+                            "host = localhost\n"
+                            "port = 8080\n"
+                            "ratio = 0.5\n"
+                            "verbose = yes\n"
+                            "[limits]\n"
+                            "buffer = 64k\n";
+
+    INIData_t *data = ini_parse_buffer(contents, sizeof(contents) - 1);
+    ASSERT_TRUE(data != NULL);
+
+    const INIBinding_t bindings[] = {
+        {"server", "host", INI_BIND_STRING, offsetof(ServerConfig_t, host), NULL},
+        {"server", "port", INI_BIND_INT, offsetof(ServerConfig_t, port), NULL},
+        {"server", "ratio", INI_BIND_DOUBLE, offsetof(ServerConfig_t, ratio), NULL},
+        {"server", "verbose", INI_BIND_BOOL, offsetof(ServerConfig_t, verbose), NULL},
+        {"limits", "buffer", INI_BIND_SIZE, offsetof(ServerConfig_t, buffer), NULL},
+        {"limits", "retries", INI_BIND_INT, offsetof(ServerConfig_t, retries), "3"},
+    };
+    const size_t count = sizeof(bindings) / sizeof(*bindings);
+    ServerConfig_t config = {0};
+    INIBindStatus_t status[sizeof(bindings) / sizeof(*bindings)];
+    ASSERT_EQ(ini_bind(data, bindings, count, &config, status), 0);
+    ASSERT_STREQ(config.host, "localhost");
+    ASSERT_EQ(config.port, 8080);
+    ASSERT_TRUE(config.ratio == 0.5);
+    ASSERT_TRUE(config.verbose);
+    ASSERT_EQ(config.buffer, 65536);
+    ASSERT_EQ(config.retries, 3);
+
+    // All failures are reported, and only failed fields keep their old contents.
+    const INIBinding_t broken[] = {
+        {"server", "host", INI_BIND_INT, offsetof(ServerConfig_t, port), NULL},
+        {"server", "missing", INI_BIND_STRING, offsetof(ServerConfig_t, host), NULL},
+        {"missing", "ratio", INI_BIND_DOUBLE, offsetof(ServerConfig_t, ratio), "nope"},
+        {"limits", "buffer", INI_BIND_INT, offsetof(ServerConfig_t, retries), NULL},
+    };
+    ASSERT_EQ(ini_bind(data, broken, 4, &config, status), 4);
+    ASSERT_EQ(status[0], INI_BIND_INVALID);
+    ASSERT_EQ(status[1], INI_BIND_MISSING);
+    ASSERT_EQ(status[2], INI_BIND_INVALID);
+    ASSERT_EQ(status[3], INI_BIND_INVALID);
+    ASSERT_EQ(config.port, 8080);
+    ASSERT_STREQ(config.host, "localhost");
+    ini_free(data);
+}
+
+
+
+TEST(ini_tests, stable_storage)
+{
+    INIData_t *data = ini_parse_buffer("[first]\nk=v\n", sizeof("[first]\nk=v\n") - 1);
+    ASSERT_TRUE(data != NULL);
+    INISection_t *first = ini_has_section(data, "first");
+    const INIEntry_t *entry = ini_pair_at(first, 0);
+    ASSERT_TRUE(first != NULL);
+
+    // Growing past several blocks moves neither sections nor pairs.
+    char name[32];
+    for (int i = 0; i < 3000; i++)
+    {
+        snprintf(name, sizeof(name), "key_%d", i);
+        const INIView_t key = {name, strlen(name)};
+        ASSERT_TRUE(ini_emplace_pair_to_section(first, key, key) != NULL);
+        snprintf(name, sizeof(name), "section_%d", i);
+        ASSERT_TRUE(ini_add_section(data, name) != NULL);
+    }
+    ASSERT_EQ(data->section_count, 3001);
+    ASSERT_EQ(first->pair_count, 3001);
+    ASSERT_TRUE(ini_has_section(data, "first") == first);
+    ASSERT_TRUE(ini_pair_at(first, 0) == entry);
+    ASSERT_STREQ(entry->value, "v");
+    ASSERT_STREQ(ini_get_value(data, "first", "key_2999"), "key_2999");
+    ASSERT_STREQ(ini_section_at(data, 3000)->name, "section_2999");
+    ASSERT_TRUE(ini_section_at(data, 3001) == NULL);
+    ASSERT_TRUE(ini_pair_at(first, 3001) == NULL);
+
+    const INIHandle_t handle = ini_resolve(data, "first", "key_2000");
+    ASSERT_EQ(handle.pair, 2001);
+    ASSERT_STREQ(ini_get_by_handle(data, handle), "key_2000");
+    ini_free(data);
+}
+
+
+
+static bool accept_short_names_(void *user, INIView_t name)
+{
+    (void)user;
+    return name.length <= 5;
+}
+
+
+
+TEST(ini_tests, filtered_sections)
+{
+    const char contents[] = "[worker]\n"
+                            "threads = 4\n"
+                            "[cache]\n"
+                            "this line would be an error\n"
+                            "[logging]\n"
+                            "level = info\n"
+                            "[cache]\n"
+                            "size = 1\n";
+
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    fputs(contents, file);
+    rewind(file);
+
+    const char *const names[] = {"worker", "logging"};
+    INIData_t *data = ini_parse_file_sections(file, names, 2);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+    ASSERT_EQ(data->section_count, 2);
+    ASSERT_STREQ(ini_get_value(data, "worker", "threads"), "4");
+    ASSERT_STREQ(ini_get_value(data, "logging", "level"), "info");
+    ASSERT_TRUE(ini_has_section(data, "cache") == NULL);
+    ini_free(data);
+
+    // Errors are still reported in the sections that are kept.
+    rewind(file);
+    const INISectionFilter_t filter = {accept_short_names_, NULL};
+    data = ini_parse_file_filtered(file, &filter);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_TRUE(data->error.encountered);
+    ASSERT_EQ(data->section_count, 0);
+    ini_free(data);
+    fclose(file);
+}
+
+
+
+TEST(ini_tests, interned_strings)
+{
+    const char first[] = "[server]\n"
+                         "host = alpha\n"
+                         "port = 80\n";
+    const char second[] = "[server]\n"
+                          "host = beta\n"
+                          "port = 80\n";
+
+    INIInternTable_t *table = ini_intern_create(true);
+    ASSERT_TRUE(table != NULL);
+    INIData_t *documents[2];
+    const char *const contents[] = {first, second};
+    for (int i = 0; i < 2; i++)
+    {
+        FILE *file = tmpfile();
+        ASSERT_TRUE(file != NULL);
+        fputs(contents[i], file);
+        rewind(file);
+        documents[i] = ini_parse_file_interned(file, table);
+        fclose(file);
+        ASSERT_TRUE(documents[i] != NULL);
+        ASSERT_FALSE(documents[i]->error.encountered);
+    }
+
+    // Shared strings are stored once.
+    const INISection_t *a = ini_has_section(documents[0], "server");
+    const INISection_t *b = ini_has_section(documents[1], "server");
+    ASSERT_TRUE(a->name == b->name);
+    ASSERT_TRUE(ini_pair_at(a, 0)->key == ini_pair_at(b, 0)->key);
+    ASSERT_TRUE(ini_get_value(documents[0], "server", "port") == ini_get_value(documents[1], "server", "port"));
+    ASSERT_EQ(ini_intern_size(table), sizeof("server") + sizeof("host") + sizeof("port") + sizeof("alpha") + sizeof("80")
+                                      + sizeof("beta"));
+
+    ASSERT_STREQ(ini_get_value(documents[1], "server", "host"), "beta");
+    ASSERT_TRUE(ini_get_value(documents[1], "server", "missing") == NULL);
+
+    // Keys added later are interned too.
+    const INIView_t key = {"extra", 5};
+    ASSERT_TRUE(ini_emplace_pair(documents[0], "server", key, key) != NULL);
+    ASSERT_STREQ(ini_get_value(documents[0], "server", "extra"), "extra");
+    ASSERT_TRUE(ini_set_value(documents[1], "server", "host", "alpha") != NULL);
+    ASSERT_TRUE(ini_get_value(documents[0], "server", "host") == ini_get_value(documents[1], "server", "host"));
+
+    ini_free(documents[0]);
+    ini_free(documents[1]);
+    ini_intern_free(table);
+}
+
+
+
+TEST(ini_tests, interned_freeze)
+{
+    // Repeated pairs share one interned value, yet only the first is indexed.
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    fputs("[a]\nx=1\nx=1\ny=2\n", file);
+    rewind(file);
+    INIInternTable_t *table = ini_intern_create(true);
+    ASSERT_TRUE(table != NULL);
+    INIData_t *data = ini_parse_file_interned(file, table);
+    fclose(file);
+    ASSERT_TRUE(data != NULL);
+    ASSERT_FALSE(data->error.encountered);
+
+    INISnapshot_t *snapshot = ini_freeze(data);
+    ASSERT_TRUE(snapshot != NULL);
+    ASSERT_STREQ(ini_snapshot_get_value(snapshot, "a", "x"), "1");
+    ASSERT_STREQ(ini_snapshot_get_value(snapshot, "a", "y"), "2");
+    ini_snapshot_free(snapshot);
+    ini_free(data);
+    ini_intern_free(table);
+}
+
+
+
+TEST(ini_tests, parse_many)
+{
+    enum { FILE_COUNT = 100 };
+    char paths[FILE_COUNT][32];
+    const char *path_list[FILE_COUNT];
+    char contents[64];
+    for (int i = 0; i < FILE_COUNT; i++)
+    {
+        strcpy(paths[i], "/tmp/ini_tests_XXXXXX");
+        const int length = snprintf(contents, sizeof(contents), "[file]\nnumber = %d\n", i);
+        write_temp_file_(paths[i], contents, (size_t)length);
+        path_list[i] = paths[i];
+    }
+
+    // Larger than one read, a broken file and a missing one.
+    size_t large_length;
+    char *large = generate_contents_(100, 20, &large_length);
+    ASSERT_TRUE(large != NULL);
+    FILE *file = fopen(paths[1], "wb");
+    ASSERT_TRUE(file != NULL);
+    fwrite(large, 1, large_length, file);
+    fclose(file);
+    free(large);
+    file = fopen(paths[2], "wb");
+    ASSERT_TRUE(file != NULL);
+    fputs("key = value\n", file);
+    fclose(file);
+    path_list[3] = "/tmp/ini_tests_missing";
+
+    INIData_t *results[FILE_COUNT];
+    ASSERT_EQ(ini_parse_many(path_list, FILE_COUNT, results), FILE_COUNT - 2);
+    ASSERT_STREQ(ini_get_value(results[0], "file", "number"), "0");
+    ASSERT_STREQ(ini_get_value(results[FILE_COUNT - 1], "file", "number"), "99");
+    ASSERT_EQ(results[1]->section_count, 100);
+    ASSERT_STREQ(ini_get_value(results[1], "section99", "key19"), "value99_19");
+    ASSERT_TRUE(results[2]->error.encountered);
+    ASSERT_TRUE(results[3] == NULL);
+
+    for (int i = 0; i < FILE_COUNT; i++)
+    {
+        ini_free(results[i]);
+        remove(paths[i]);
+    }
+}
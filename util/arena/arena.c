@@ -1,6 +1,7 @@
 #include "arena.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 void arena_init(arena_t *arena, void *allocation, size_t size)
@@ -24,8 +25,24 @@ void *arena_alloc(arena_t *arena, size_t size)
     assert(arena->ptr);
     assert(arena->end);
 
-    if (arena_available(arena) < size) return NULL;
+    if ((size_t)arena_available(arena) < size) return NULL;
     void *allocation = arena->ptr;
     arena->ptr += size;
     return allocation;
 }
+
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t alignment)
+{
+    assert(arena);
+    assert(alignment && (alignment & (alignment - 1)) == 0);
+
+    const uintptr_t address = (uintptr_t)arena->ptr;
+    const size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+    if ((size_t)arena_available(arena) < padding) return NULL;
+
+    void *ptr = arena->ptr;
+    arena->ptr += padding;
+    void *allocation = arena_alloc(arena, size);
+    if (!allocation) arena->ptr = ptr;
+    return allocation;
+}
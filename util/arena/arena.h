@@ -13,6 +13,7 @@ typedef struct
 void arena_init(arena_t *arena, void *allocation, size_t size);
 void arena_clear(arena_t *arena);
 void *arena_alloc(arena_t *arena, size_t size);
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t alignment);
 
 static inline ptrdiff_t arena_size(const arena_t *arena)
 {
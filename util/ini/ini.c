@@ -3,451 +3,3084 @@
 
 
 #include <assert.h>
-#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
-#define INITIAL_ALLOCATED_PAIRS 32
-#define INITIAL_ALLOCATED_SECTIONS 8
+#if defined(__unix__) || defined(__APPLE__)
+#define INI_USE_MMAP
+#define INI_USE_THREADS
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 
 
-static void set_parse_error_(INIData_t *data, const char *line, const char *msg)
+#define PAIR_BLOCK_SHIFT 2
+#define SECTION_BLOCK_SHIFT 2
+#define INITIAL_STRING_BLOCK_SIZE 512
+#define INITIAL_INTERNED_STRING_BLOCK_SIZE 64
+#define MAX_STRING_BLOCK_SIZE 65536
+#define INTERN_CHUNK_SIZE 65536
+#define INITIAL_INTERN_CAPACITY 256
+#define INDEX_THRESHOLD 8
+#define PAIR_INDEX_THRESHOLD 32
+#define INITIAL_INDEX_CAPACITY 32
+#define MIN_PARALLEL_CHUNK_SIZE 65536
+#define MAX_PARALLEL_CHUNKS 256
+#define QUERY_STACK_SIZE 64
+
+
+
+#define MISSING_SECTION_MESSAGE "Pairs must reside within a section."
+#define BAD_PAIR_MESSAGE "Failed to parse pair."
+#define BAD_SECTION_MESSAGE "Failed to parse section."
+
+
+
+typedef enum
+{
+    TOKEN_BLANK,
+    TOKEN_PAIR,
+    TOKEN_SECTION,
+    TOKEN_BAD_PAIR,
+    TOKEN_BAD_SECTION,
+} INIToken_t;
+
+
+
+/*
+ * States of the line scanner, see run_machine_(). STATE_LINE,
+ * STATE_PAIR and STATE_SECTION are where scanning a whole line, a
+ * pair or a section starts. The first three are not states the
+ * scanner stays in but the ways it stops: at a character that is
+ * not allowed, at a comment, which ends the line, or at a '['
+ * following a key or value.
+ */
+enum
+{
+    STATE_FAIL,
+    STATE_END,
+    STATE_BRACKET,
+    STATE_LINE,
+    STATE_PAIR,
+    STATE_SECTION,
+    STATE_KEY,
+    STATE_KEY_END,
+    STATE_VALUE_START,
+    STATE_VALUE,
+    STATE_QUOTED,
+    STATE_VALUE_END,
+    STATE_SECTION_OPEN,
+    STATE_NAME,
+    STATE_NAME_END,
+    STATE_SECTION_END,
+    STATE_COUNT
+};
+
+
+
+/*
+ * Character classes of the line scanner. Every byte belongs to
+ * exactly one class; bytes of 0x80 and above are never valid.
+ */
+enum
+{
+    CLASS_OTHER,
+    CLASS_WHITESPACE,
+    CLASS_SPACE,
+    CLASS_COMMENT,
+    CLASS_ALPHA,
+    CLASS_DIGIT,
+    CLASS_EQUALS,
+    CLASS_QUOTE,
+    CLASS_OPEN,
+    CLASS_CLOSE,
+    CLASS_SPECIAL,
+    CLASS_COUNT
+};
+
+#define CLASS_BIT_(class) (1u << (class))
+#define IGNORED_CLASSES (CLASS_BIT_(CLASS_WHITESPACE) | CLASS_BIT_(CLASS_SPACE))
+#define NAME_CLASSES (CLASS_BIT_(CLASS_ALPHA) | CLASS_BIT_(CLASS_DIGIT))
+#define VALUE_CLASSES (NAME_CLASSES | CLASS_BIT_(CLASS_OPEN) | CLASS_BIT_(CLASS_CLOSE) | CLASS_BIT_(CLASS_SPECIAL))
+#define QUOTED_VALUE_CLASSES (VALUE_CLASSES | CLASS_BIT_(CLASS_SPACE))
+
+
+
+typedef enum
+{
+    CACHE_NONE,
+    CACHE_INT,
+    CACHE_DOUBLE,
+    CACHE_BOOL,
+    CACHE_SIZE,
+} INICacheType_t;
+
+
+
+typedef enum
+{
+    LINE_OK,
+    LINE_INVALID,
+    LINE_OUT_OF_MEMORY,
+} INILineStatus_t;
+
+
+
+struct INIStringBlock
+{
+    struct INIStringBlock *next;
+    size_t used;
+    size_t size;
+    char bytes[];
+};
+
+
+
+/*
+ * Interned string, followed by a null byte in the arena of its
+ * table. Empty slots have a NULL `str`.
+ */
+struct INIInternSlot
+{
+    const char *str;
+    size_t length;
+    uint32_t hash;
+};
+
+
+
+struct INIInternChunk
+{
+    struct INIInternChunk *next;
+    char bytes[];
+};
+
+
+
+/*
+ * Strings are copied into `arena`, which spans the newest of
+ * `chunks`; a string that does not fit in it starts a new one.
+ * `size` counts the bytes taken by strings.
+ */
+struct INIInternTable
+{
+    struct INIInternSlot *slots;
+    size_t capacity;
+    size_t count;
+    arena_t arena;
+    struct INIInternChunk *chunks;
+    size_t size;
+    bool values;
+};
+
+
+
+/*
+ * Open-addressing hash index slot. `position` is the index
+ * of the item plus one, so that zero marks an empty slot.
+ */
+struct INIIndexSlot
+{
+    uint32_t hash;
+    uint32_t position;
+};
+
+
+
+/*
+ * Sorted key entry. `head` holds the first bytes of the key in
+ * big-endian order, so that most comparisons while searching never
+ * touch the key itself.
+ */
+struct INIKeyOrder
+{
+    uint64_t head;
+    const char *key;
+    size_t position;
+};
+
+
+
+static INIToken_t run_machine_(const char *line, size_t length, unsigned char start, INIView_t *first, INIView_t *second, ptrdiff_t *error_offset);
+static bool in_classes_(char c, unsigned classes);
+static const char *skip_ignored_characters_(const char *c, const char *end);
+static unsigned find_hash_(const uint32_t *hashes, unsigned start, unsigned count, uint32_t hash);
+
+
+
+static void set_parse_error_(INIData_t *data, const char *line, size_t length, const char *msg)
 {
     assert(data);
     if (!data || data->error.offset < 0) return;
 
+    if (length >= INI_MAX_LINE_SIZE) length = INI_MAX_LINE_SIZE - 1;
     data->error.encountered = true;
     memset(data->error.line, 0, sizeof(data->error.line));
-    strncpy(data->error.line, line, strnlen(line, INI_MAX_LINE_SIZE));
+    memcpy(data->error.line, line, length);
+    memset(data->error.msg, 0, sizeof(data->error.msg));
+    strncpy(data->error.msg, msg, INI_MAX_LINE_SIZE - 1);
+}
+
+
+
+/*
+ * Allocation helpers. Documents and sections created with an arena
+ * allocate from it and never free individual allocations; outgrown
+ * storage is simply abandoned until the arena is cleared.
+ */
+static void *allocate_(arena_t *arena, size_t size)
+{
+    if (!arena) return malloc(size);
+    return arena_alloc_aligned(arena, size, _Alignof(max_align_t));
+}
+
+
+
+static void *allocate_zeroed_(arena_t *arena, size_t count, size_t size)
+{
+    if (!arena) return calloc(count, size);
+    void *allocation = allocate_(arena, count * size);
+    if (allocation) memset(allocation, 0, count * size);
+    return allocation;
+}
+
+
+
+static void deallocate_(arena_t *arena, void *ptr)
+{
+    if (!arena) free(ptr);
+}
+
+
+
+static void free_section_strings_(INISection_t *section)
+{
+    struct INIStringBlock *block = section->strings;
+    while (block)
+    {
+        struct INIStringBlock *next = block->next;
+        deallocate_(section->arena, block);
+        block = next;
+    }
+    section->strings = NULL;
+}
+
+
+
+/*
+ * Block lists. Block `b` of a list whose first block holds 1 << shift
+ * items holds 1 << (shift + b) items, so item `i` is found from the
+ * highest set bit of (i >> shift) + 1 without walking the list.
+ */
+static unsigned highest_set_bit_(size_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (unsigned)index;
+#else
+    return 63 - (unsigned)__builtin_clzll((unsigned long long)value);
+#endif
+}
+
+
+
+static size_t block_size_(unsigned block, unsigned shift)
+{
+    return (size_t)1 << (shift + block);
+}
+
+
+
+// Returns the block holding item `index`, and its offset within that block in `offset`.
+static unsigned block_of_(size_t index, unsigned shift, size_t *offset)
+{
+    const unsigned block = highest_set_bit_((index >> shift) + 1);
+    *offset = index - ((((size_t)1 << block) - 1) << shift);
+    return block;
+}
+
+
+
+// The key hashes of a pair block follow its pairs.
+static uint32_t *block_hashes_(INIEntry_t *block, unsigned index)
+{
+    return (uint32_t *)(block + block_size_(index, PAIR_BLOCK_SHIFT));
+}
+
+
+
+static INISection_t *section_at_(const INIData_t *data, size_t index)
+{
+    size_t offset;
+    const unsigned block = block_of_(index, SECTION_BLOCK_SHIFT, &offset);
+    return &data->section_blocks[block][offset];
+}
+
+
+
+static INIEntry_t *pair_at_(const INISection_t *section, size_t index)
+{
+    size_t offset;
+    const unsigned block = block_of_(index, PAIR_BLOCK_SHIFT, &offset);
+    return &section->pair_blocks[block][offset];
+}
+
+
+
+static uint32_t *pair_hash_(const INISection_t *section, size_t index)
+{
+    size_t offset;
+    const unsigned block = block_of_(index, PAIR_BLOCK_SHIFT, &offset);
+    return &block_hashes_(section->pair_blocks[block], block)[offset];
+}
+
+
+
+// Finds the index of an item from its address by checking which block holds it.
+static size_t block_position_(const void *const *blocks, size_t item_size, unsigned shift, const void *item)
+{
+    const uintptr_t address = (uintptr_t)item;
+    size_t first = 0;
+    for (unsigned block = 0; block < INI_MAX_BLOCKS && blocks[block]; block++)
+    {
+        const uintptr_t begin = (uintptr_t)blocks[block];
+        const size_t size = block_size_(block, shift);
+        if (address >= begin && address < begin + item_size * size) return first + (address - begin) / item_size;
+        first += size;
+    }
+    return SIZE_MAX;
+}
+
+
+
+static size_t section_position_(const INIData_t *data, const INISection_t *section)
+{
+    return block_position_((const void *const *)data->section_blocks, sizeof(INISection_t), SECTION_BLOCK_SHIFT,
+                           section);
+}
+
+
+
+static size_t pair_position_(const INISection_t *section, const INIEntry_t *entry)
+{
+    return block_position_((const void *const *)section->pair_blocks, sizeof(INIEntry_t), PAIR_BLOCK_SHIFT, entry);
+}
+
+
+
+// Returns room for section `index`, allocating its block if needed.
+static INISection_t *section_slot_(INIData_t *data, size_t index)
+{
+    size_t offset;
+    const unsigned block = block_of_(index, SECTION_BLOCK_SHIFT, &offset);
+    if (block >= INI_MAX_BLOCKS) return NULL;
+    if (!data->section_blocks[block])
+        data->section_blocks[block] = allocate_(data->arena, sizeof(INISection_t) * block_size_(block, SECTION_BLOCK_SHIFT));
+    return data->section_blocks[block] ? &data->section_blocks[block][offset] : NULL;
+}
+
+
+
+// Returns room for pair `index`, allocating its block, along with room for the key hashes, if needed.
+static INIEntry_t *pair_slot_(INISection_t *section, size_t index)
+{
+    size_t offset;
+    const unsigned block = block_of_(index, PAIR_BLOCK_SHIFT, &offset);
+    if (block >= INI_MAX_BLOCKS) return NULL;
+    if (!section->pair_blocks[block])
+        section->pair_blocks[block] = allocate_(section->arena, (sizeof(INIEntry_t) + sizeof(uint32_t)) * block_size_(block, PAIR_BLOCK_SHIFT));
+    return section->pair_blocks[block] ? &section->pair_blocks[block][offset] : NULL;
+}
+
+
+
+static void free_data_sections_(INIData_t *data)
+{
+    if (data)
+    {
+        for (size_t i = 0; i < data->section_count; i++)
+        {
+            INISection_t *section = section_at_(data, i);
+            for (unsigned j = 0; j < INI_MAX_BLOCKS; j++)
+                deallocate_(data->arena, section->pair_blocks[j]);
+            deallocate_(data->arena, section->index);
+            deallocate_(data->arena, section->order);
+            free_section_strings_(section);
+        }
+        for (unsigned i = 0; i < INI_MAX_BLOCKS; i++)
+        {
+            deallocate_(data->arena, data->section_blocks[i]);
+            data->section_blocks[i] = NULL;
+        }
+        deallocate_(data->arena, data->section_index);
+        data->section_count = 0;
+        data->section_index = NULL;
+        data->section_index_capacity = 0;
+    }
+}
+
+
+
+static void free_data_buffer_(INIData_t *data)
+{
+    if (!data || !data->buffer.begin) return;
+#ifdef INI_USE_MMAP
+    if (data->buffer.mapped)
+        munmap(data->buffer.begin, data->buffer.size);
+    else
+#endif
+        free(data->buffer.begin);
+    data->buffer.begin = NULL;
+    data->buffer.size = 0;
+    data->buffer.mapped = false;
+}
+
+
+
+static INIData_t *create_data_(arena_t *arena)
+{
+    INIData_t *data = allocate_(arena, sizeof(INIData_t));
+    if (!data) return NULL;
+
+    data->error.encountered = false;
     memset(data->error.msg, 0, sizeof(data->error.msg));
-    strncpy(data->error.msg, msg, strnlen(msg, INI_MAX_LINE_SIZE));
+    memset(data->error.line, 0, sizeof(data->error.line));
+    data->error.offset = 0;
+    data->buffer.begin = NULL;
+    data->buffer.size = 0;
+    data->buffer.mapped = false;
+    data->arena = arena;
+    memset(data->section_blocks, 0, sizeof(data->section_blocks));
+    data->section_count = 0;
+    data->section_index = NULL;
+    data->section_index_capacity = 0;
+    data->generation = 1;
+    data->intern = NULL;
+    return data;
+}
+
+
+
+// FNV-1a
+static uint32_t hash_string_(const char *str, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+
+static void index_place_(struct INIIndexSlot *slots, unsigned capacity, struct INIIndexSlot slot)
+{
+    unsigned i = slot.hash & (capacity - 1);
+    while (slots[i].position)
+        i = (i + 1) & (capacity - 1);
+    slots[i] = slot;
+}
+
+
+
+/*
+ * Records `position` in an index holding `count` items, counting the
+ * new one. The index is grown to stay at most half full. If that fails,
+ * the index is dropped and lookups fall back to a linear scan until it
+ * can be rebuilt.
+ */
+static void index_insert_(arena_t *arena, struct INIIndexSlot **slots, unsigned *capacity, unsigned count, uint32_t hash, unsigned position)
+{
+    if (count * 2 > *capacity)
+    {
+        const unsigned new_capacity = *capacity ? *capacity * 2 : INITIAL_INDEX_CAPACITY;
+        struct INIIndexSlot *new_slots = allocate_zeroed_(arena, new_capacity, sizeof(struct INIIndexSlot));
+        if (new_slots)
+            for (unsigned i = 0; i < *capacity; i++)
+                if ((*slots)[i].position)
+                    index_place_(new_slots, new_capacity, (*slots)[i]);
+        deallocate_(arena, *slots);
+        *slots = new_slots;
+        *capacity = new_slots ? new_capacity : 0;
+        if (!new_slots) return;
+    }
+    const struct INIIndexSlot slot = {hash, position};
+    index_place_(*slots, *capacity, slot);
+}
+
+
+
+static void section_init_(arena_t *arena, INISection_t *section)
+{
+    section->name = "";
+    section->name_length = 0;
+    section->arena = arena;
+    memset(section->pair_blocks, 0, sizeof(section->pair_blocks));
+    section->pair_count = 0;
+    section->strings = NULL;
+    section->index = NULL;
+    section->index_capacity = 0;
+    section->pending = NULL;
+    section->pending_length = 0;
+    section->order = NULL;
+    section->order_count = 0;
+    section->intern = NULL;
+}
+
+
+
+/*
+ * Copies a string into the section's string storage and null-terminates
+ * it. A section with an intern table only stores values here, if any,
+ * so its first block starts out smaller.
+ */
+static char *store_string_(INISection_t *section, const char *str, size_t length)
+{
+    struct INIStringBlock *block = section->strings;
+    if (!block || block->size - block->used < length + 1)
+    {
+        const size_t initial_size = section->intern ? INITIAL_INTERNED_STRING_BLOCK_SIZE : INITIAL_STRING_BLOCK_SIZE;
+        size_t size = block && block->size >= initial_size ? block->size * 2 : initial_size;
+        if (size > MAX_STRING_BLOCK_SIZE) size = MAX_STRING_BLOCK_SIZE;
+        if (size < length + 1) size = length + 1;
+
+        block = allocate_(section->arena, sizeof(struct INIStringBlock) + size);
+        if (!block) return NULL;
+        block->used = 0;
+        block->size = size;
+        block->next = section->strings;
+        section->strings = block;
+    }
+
+    char *dest = block->bytes + block->used;
+    memcpy(dest, str, length);
+    dest[length] = '\0';
+    block->used += length + 1;
+    return dest;
+}
+
+
+
+static void intern_place_(struct INIInternSlot *slots, size_t capacity, struct INIInternSlot slot)
+{
+    size_t i = slot.hash & (capacity - 1);
+    while (slots[i].str)
+        i = (i + 1) & (capacity - 1);
+    slots[i] = slot;
+}
+
+
+
+// Returns the interned copy of a string with the given hash, or NULL if it has not been interned.
+static const char *find_interned_(const INIInternTable_t *table, const char *str, size_t length, uint32_t hash)
+{
+    if (!table->capacity) return NULL;
+    const size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask; table->slots[i].str; i = (i + 1) & mask)
+    {
+        const struct INIInternSlot *slot = &table->slots[i];
+        if (slot->hash == hash && slot->length == length && memcmp(slot->str, str, length) == 0)
+            return slot->str;
+    }
+    return NULL;
+}
+
+
+
+// Copies a string into the arena of the table and null-terminates it.
+static const char *intern_copy_(INIInternTable_t *table, const char *str, size_t length)
+{
+    char *copy = table->chunks ? arena_alloc(&table->arena, length + 1) : NULL;
+    if (!copy)
+    {
+        const size_t size = length + 1 > INTERN_CHUNK_SIZE ? length + 1 : INTERN_CHUNK_SIZE;
+        struct INIInternChunk *chunk = malloc(sizeof(struct INIInternChunk) + size);
+        if (!chunk) return NULL;
+        chunk->next = table->chunks;
+        table->chunks = chunk;
+        arena_init(&table->arena, chunk->bytes, size);
+        copy = arena_alloc(&table->arena, length + 1);
+    }
+
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    table->size += length + 1;
+    return copy;
+}
+
+
+
+// Returns the interned copy of a string, interning it first if needed.
+static const char *intern_(INIInternTable_t *table, const char *str, size_t length)
+{
+    const uint32_t hash = hash_string_(str, length);
+    const char *interned = find_interned_(table, str, length, hash);
+    if (interned) return interned;
+
+    if ((table->count + 1) * 2 > table->capacity)
+    {
+        const size_t capacity = table->capacity ? table->capacity * 2 : INITIAL_INTERN_CAPACITY;
+        struct INIInternSlot *slots = calloc(capacity, sizeof(struct INIInternSlot));
+        if (!slots) return NULL;
+        for (size_t i = 0; i < table->capacity; i++)
+            if (table->slots[i].str) intern_place_(slots, capacity, table->slots[i]);
+        free(table->slots);
+        table->slots = slots;
+        table->capacity = capacity;
+    }
+
+    const struct INIInternSlot slot = {intern_copy_(table, str, length), length, hash};
+    if (!slot.str) return NULL;
+    intern_place_(table->slots, table->capacity, slot);
+    table->count++;
+    return slot.str;
+}
+
+
+
+/*
+ * Copies the name of a section into a string block of its own that
+ * fits it exactly, so that a section whose pairs are never copied,
+ * as in ini_parse_mapped(), does not take a whole block for it. A
+ * section with an intern table shares the name through the table.
+ */
+static bool store_section_name_(INISection_t *section, const char *name, size_t length)
+{
+    if (section->intern)
+    {
+        section->name = intern_(section->intern, name, length);
+        section->name_length = length;
+        return section->name != NULL;
+    }
+
+    struct INIStringBlock *block = allocate_(section->arena, sizeof(struct INIStringBlock) + length + 1);
+    if (!block) return false;
+    block->used = length + 1;
+    block->size = length + 1;
+    block->next = section->strings;
+    section->strings = block;
+
+    memcpy(block->bytes, name, length);
+    block->bytes[length] = '\0';
+    section->name = block->bytes;
+    section->name_length = length;
+    return true;
+}
+
+
+
+// Values are only interned if the table of the section was created to.
+static const char *store_value_(INISection_t *section, const char *str, size_t length)
+{
+    if (section->intern && section->intern->values) return intern_(section->intern, str, length);
+    return store_string_(section, str, length);
+}
+
+
+
+// Interned keys are compared by address, see find_entry_().
+static bool keys_equal_(const INISection_t *section, const INIEntry_t *entry, const char *key, size_t length)
+{
+    if (section->intern) return entry->key == key;
+    return entry->key_length == length && memcmp(entry->key, key, length) == 0;
+}
+
+
+
+static bool section_name_equals_(const INISection_t *section, const char *name, size_t length)
+{
+    return section->name_length == length && memcmp(section->name, name, length) == 0;
+}
+
+
+
+static INISection_t *find_section_(const INIData_t *data, const char *name, size_t length)
+{
+    if (data->section_index)
+    {
+        const unsigned mask = data->section_index_capacity - 1;
+        const uint32_t hash = hash_string_(name, length);
+        for (unsigned i = hash & mask; data->section_index[i].position; i = (i + 1) & mask)
+        {
+            INISection_t *section = section_at_(data, data->section_index[i].position - 1);
+            if (data->section_index[i].hash == hash && section_name_equals_(section, name, length))
+                return section;
+        }
+        return NULL;
+    }
+
+    for (size_t i = 0; i < data->section_count; i++)
+    {
+        INISection_t *section = section_at_(data, i);
+        if (section_name_equals_(section, name, length))
+            return section;
+    }
+    return NULL;
+}
+
+
+
+static INIEntry_t *find_entry_(const INISection_t *section, const char *key, size_t length)
+{
+    const uint32_t hash = hash_string_(key, length);
+    // A key that was never interned is in no section using the table.
+    if (section->intern && !(key = find_interned_(section->intern, key, length, hash))) return NULL;
+
+    if (section->index)
+    {
+        const unsigned mask = section->index_capacity - 1;
+        for (unsigned i = hash & mask; section->index[i].position; i = (i + 1) & mask)
+        {
+            INIEntry_t *entry = pair_at_(section, section->index[i].position - 1);
+            if (section->index[i].hash == hash && keys_equal_(section, entry, key, length))
+                return entry;
+        }
+        return NULL;
+    }
+
+    // Only pairs whose key hash matches are looked at, one block at a time.
+    size_t first = 0;
+    for (unsigned block = 0; first < section->pair_count; block++)
+    {
+        const size_t size = block_size_(block, PAIR_BLOCK_SHIFT);
+        const unsigned count = (unsigned)(section->pair_count - first < size ? section->pair_count - first : size);
+        const uint32_t *hashes = block_hashes_(section->pair_blocks[block], block);
+        for (unsigned i = find_hash_(hashes, 0, count, hash); i < count; i = find_hash_(hashes, i + 1, count, hash))
+        {
+            INIEntry_t *entry = &section->pair_blocks[block][i];
+            if (keys_equal_(section, entry, key, length))
+                return entry;
+        }
+        first += size;
+    }
+    return NULL;
+}
+
+
+
+static void index_section_(INIData_t *data, size_t position)
+{
+    if (data->section_index)
+    {
+        const INISection_t *section = section_at_(data, position - 1);
+        const uint32_t hash = hash_string_(section->name, section->name_length);
+        index_insert_(data->arena, &data->section_index, &data->section_index_capacity, (unsigned)data->section_count, hash, (unsigned)position);
+        return;
+    }
+
+    if (data->section_count < INDEX_THRESHOLD) return;
+    for (size_t i = 1; i <= data->section_count; i++)
+    {
+        const INISection_t *section = section_at_(data, i - 1);
+        const uint32_t hash = hash_string_(section->name, section->name_length);
+        index_insert_(data->arena, &data->section_index, &data->section_index_capacity, (unsigned)i, hash, (unsigned)i);
+        if (!data->section_index) return;
+    }
+}
+
+
+
+// Only the first of several pairs sharing a key is indexed, matching a linear scan.
+static void index_entry_(INISection_t *section, size_t position)
+{
+    if (section->index)
+    {
+        const INIEntry_t *entry = pair_at_(section, position - 1);
+        if (find_entry_(section, entry->key, entry->key_length)) return;
+        const uint32_t hash = *pair_hash_(section, position - 1);
+        index_insert_(section->arena, &section->index, &section->index_capacity, (unsigned)section->pair_count, hash, (unsigned)position);
+        return;
+    }
+
+    if (section->pair_count < PAIR_INDEX_THRESHOLD) return;
+    for (size_t i = 1; i <= section->pair_count; i++)
+    {
+        const INIEntry_t *entry = pair_at_(section, i - 1);
+        if (section->index && find_entry_(section, entry->key, entry->key_length)) continue;
+        const uint32_t hash = *pair_hash_(section, i - 1);
+        index_insert_(section->arena, &section->index, &section->index_capacity, (unsigned)i, hash, (unsigned)i);
+        if (!section->index) return;
+    }
+}
+
+
+
+// Appends an entry whose strings are already null-terminated and owned elsewhere.
+static INIEntry_t *add_entry_(INISection_t *section, const char *key, size_t key_length, const char *value, size_t value_length)
+{
+    INIEntry_t *entry = pair_slot_(section, section->pair_count);
+    if (!entry) return NULL;
+
+    *pair_hash_(section, section->pair_count) = hash_string_(key, key_length);
+    section->pair_count++;
+    entry->key = key;
+    entry->value = value;
+    entry->key_length = key_length;
+    entry->value_length = value_length;
+    entry->cache.type = CACHE_NONE;
+    index_entry_(section, section->pair_count);
+    return entry;
+}
+
+
+
+static INIEntry_t *copy_entry_(INISection_t *section, INIView_t key, INIView_t value)
+{
+    const char *key_copy = section->intern ? intern_(section->intern, key.ptr, key.length)
+                                           : store_string_(section, key.ptr, key.length);
+    const char *value_copy = store_value_(section, value.ptr, value.length);
+    if (!key_copy || !value_copy) return NULL;
+    return add_entry_(section, key_copy, key.length, value_copy, value.length);
+}
+
+
+
+static INISection_t *add_section_(INIData_t *data, const char *name, size_t length)
+{
+    INISection_t *section = section_slot_(data, data->section_count);
+    if (!section) return NULL;
+    section_init_(data->arena, section);
+    section->intern = data->intern;
+    if (!store_section_name_(section, name, length)) return NULL;
+    data->section_count++;
+    index_section_(data, data->section_count);
+    return section;
+}
+
+
+
+/*
+ * Classifies a single line of `length` bytes. For pairs, `first` and
+ * `second` receive the key and value; for sections, `first` receives
+ * the name. `error_offset` is set the same way as by ini_parse_pair()
+ * and ini_parse_section().
+ */
+static INIToken_t tokenize_line_(const char *line, size_t length, INIView_t *first, INIView_t *second, ptrdiff_t *error_offset)
+{
+    return run_machine_(line, length, STATE_LINE, first, second, error_offset);
+}
+
+
+
+/*
+ * Parses a single line of at most `length` bytes. If `in_place`
+ * is set, the line belongs to the document's buffer; keys and
+ * values are null-terminated within it instead of being copied.
+ * Running out of memory is left for the caller to report.
+ */
+static INILineStatus_t parse_line_(INIData_t *data, INISection_t **current_section, const char *line, size_t length, bool in_place)
+{
+    INIView_t first, second;
+    switch (tokenize_line_(line, length, &first, &second, &data->error.offset))
+    {
+        case TOKEN_BLANK:
+            return LINE_OK;
+
+        case TOKEN_PAIR:
+        {
+            if (!*current_section)
+            {
+                set_parse_error_(data, line, length, MISSING_SECTION_MESSAGE);
+                return LINE_INVALID;
+            }
+
+            const INIEntry_t *entry;
+            if (in_place)
+            {
+                // Both strings are followed by an ignored character, '=' or
+                // the end of the buffer, all of which are safe to overwrite.
+                char *const buffer = (char *)line;
+                buffer[first.ptr - line + first.length] = '\0';
+                buffer[second.ptr - line + second.length] = '\0';
+                entry = add_entry_(*current_section, first.ptr, first.length, second.ptr, second.length);
+            }
+            else
+                entry = copy_entry_(*current_section, first, second);
+
+            return entry ? LINE_OK : LINE_OUT_OF_MEMORY;
+        }
+
+        case TOKEN_SECTION:
+            if (find_section_(data, first.ptr, first.length))
+            {
+                char buffer[INI_MAX_LINE_SIZE];
+                snprintf(buffer, INI_MAX_LINE_SIZE, "Duplicate section '%.*s'.", (int)first.length, first.ptr);
+                set_parse_error_(data, line, length, buffer);
+                return LINE_INVALID;
+            }
+            *current_section = add_section_(data, first.ptr, first.length);
+            return *current_section ? LINE_OK : LINE_OUT_OF_MEMORY;
+
+        case TOKEN_BAD_PAIR:
+            set_parse_error_(data, line, length, BAD_PAIR_MESSAGE);
+            return LINE_INVALID;
+
+        case TOKEN_BAD_SECTION:
+            set_parse_error_(data, line, length, BAD_SECTION_MESSAGE);
+            return LINE_INVALID;
+    }
+    assert(false);
+    return LINE_INVALID;
+}
+
+
+
+/*
+ * Copies an arena-backed document onto the heap, keeping
+ * `current_section` pointed at the equivalent section.
+ */
+static INIData_t *move_to_heap_(const INIData_t *data, INISection_t **current_section)
+{
+    INIData_t *copy = create_data_(NULL);
+    if (!copy) return NULL;
+
+    for (size_t i = 0; i < data->section_count; i++)
+    {
+        const INISection_t *section = section_at_(data, i);
+        INISection_t *section_copy = add_section_(copy, section->name, section->name_length);
+        if (!section_copy) goto copy_failure;
+        for (size_t j = 0; j < section->pair_count; j++)
+        {
+            const INIEntry_t *entry = pair_at_(section, j);
+            const INIView_t key = {entry->key, entry->key_length};
+            const INIView_t value = {entry->value, entry->value_length};
+            if (!copy_entry_(section_copy, key, value)) goto copy_failure;
+        }
+    }
+
+    if (*current_section)
+        *current_section = section_at_(copy, section_position_(data, *current_section));
+    return copy;
+
+    copy_failure:
+    ini_free(copy);
+    return NULL;
+}
+
+
+
+/*
+ * Reads the next line of `file`, newline included, into `*line`,
+ * growing it as needed so that lines of any length fit. Returns
+ * false at the end of the file, or if the line does not fit in
+ * memory.
+ *
+ * Null bytes read from the file are kept in the line, so that the
+ * line fails to parse there instead of being cut short. fgets() does
+ * not say how much it read, so the room it is given is filled with
+ * non-zero bytes first and its terminator is the last null byte.
+ */
+static bool read_line_(FILE *file, char **line, size_t *capacity, size_t *length)
+{
+    *length = 0;
+    for (;;)
+    {
+        if (*capacity - *length < INI_MAX_LINE_SIZE)
+        {
+            const size_t grown = *capacity ? *capacity * 2 : INI_MAX_LINE_SIZE;
+            char *re = realloc(*line, grown);
+            if (!re) return false;
+            *line = re;
+            *capacity = grown;
+        }
+
+        char *const chunk = *line + *length;
+        memset(chunk, '\n', INI_MAX_LINE_SIZE);
+        if (!fgets(chunk, INI_MAX_LINE_SIZE, file)) return *length > 0;
+
+        size_t read = strlen(chunk);
+        // Unless the chunk ended at a newline or filled its room, strlen() may have stopped at a null byte.
+        if ((read == 0 || chunk[read - 1] != '\n') && read < INI_MAX_LINE_SIZE - 1)
+        {
+            read = INI_MAX_LINE_SIZE - 1;
+            while (chunk[read] != '\0') read--;
+        }
+        *length += read;
+        if (read > 0 && chunk[read - 1] == '\n') return true;
+        if (read < INI_MAX_LINE_SIZE - 1) return true;
+    }
+}
+
+
+
+/*
+ * Decides whether the section opened by a line is skipped. Lines
+ * that do not start with '[' leave the decision as it was, without
+ * being tokenized. A bad header is left for parse_line_() to report.
+ */
+static bool skip_section_(const INISectionFilter_t *filter, const char *line, size_t length, bool skipping)
+{
+    const char *const end = line + length;
+    const char *first = line;
+    while (first < end && in_classes_(*first, IGNORED_CLASSES)) first++;
+    if (first == end || *first != '[') return skipping;
+
+    INIView_t name, unused;
+    ptrdiff_t error_offset;
+    if (tokenize_line_(line, length, &name, &unused, &error_offset) != TOKEN_SECTION) return false;
+    return !filter->accept(filter->user, name);
+}
+
+
+
+static INIData_t *parse_file_(FILE *file, arena_t *arena, const INISectionFilter_t *filter, INIInternTable_t *intern)
+{
+    void *const mark = arena ? arena->ptr : NULL;
+    INIData_t *data = create_data_(arena);
+    if (!data && arena)
+    {
+        arena->ptr = mark;
+        data = create_data_(NULL);
+    }
+    if (!data) return NULL;
+    data->intern = intern;
+
+    char *line = NULL;
+    size_t capacity = 0;
+    size_t length;
+    INISection_t *current_section = NULL;
+    bool skipping = false;
+    while (read_line_(file, &line, &capacity, &length))
+    {
+        if (filter && (skipping = skip_section_(filter, line, length, skipping))) continue;
+
+        INILineStatus_t status = parse_line_(data, &current_section, line, length, false);
+        if (status == LINE_OUT_OF_MEMORY && data->arena)
+        {
+            // The arena is exhausted, so continue with the document on the heap
+            // and give the arena back its space.
+            INIData_t *heap_data = move_to_heap_(data, &current_section);
+            if (heap_data)
+            {
+                arena->ptr = mark;
+                data = heap_data;
+                status = parse_line_(data, &current_section, line, length, false);
+            }
+        }
+
+        if (status == LINE_OUT_OF_MEMORY)
+            set_parse_error_(data, line, length, "Out of memory.");
+        if (status != LINE_OK)
+        {
+            free_data_sections_(data);
+            break;
+        }
+    }
+
+    // Stopping short of the end without an error means a line did not fit in memory.
+    if (!data->error.encountered && !feof(file) && !ferror(file))
+    {
+        set_parse_error_(data, line ? line : "", line ? strlen(line) : 0, "Out of memory.");
+        free_data_sections_(data);
+    }
+    free(line);
+    return data;
+}
+
+
+
+INIData_t *ini_parse_file(FILE *file)
+{
+    if (!file) return NULL;
+    return parse_file_(file, NULL, NULL, NULL);
+}
+
+
+
+INIData_t *ini_parse_file_arena(FILE *file, arena_t *arena)
+{
+    if (!file) return NULL;
+    assert(arena);
+    return parse_file_(file, arena, NULL, NULL);
+}
+
+
+
+INIData_t *ini_parse_file_filtered(FILE *file, const INISectionFilter_t *filter)
+{
+    assert(filter);
+    if (!file || !filter || !filter->accept) return NULL;
+    return parse_file_(file, NULL, filter, NULL);
+}
+
+
+
+typedef struct
+{
+    const char *const *names;
+    size_t count;
+} INIAllowlist_t;
+
+
+
+static bool is_allowed_(void *user, INIView_t name)
+{
+    const INIAllowlist_t *allowlist = user;
+    for (size_t i = 0; i < allowlist->count; i++)
+        if (strncmp(allowlist->names[i], name.ptr, name.length) == 0 && allowlist->names[i][name.length] == '\0')
+            return true;
+    return false;
+}
+
+
+
+INIData_t *ini_parse_file_sections(FILE *file, const char *const *names, size_t count)
+{
+    assert(names || !count);
+    if (!names && count) return NULL;
+
+    INIAllowlist_t allowlist = {names, count};
+    const INISectionFilter_t filter = {is_allowed_, &allowlist};
+    return ini_parse_file_filtered(file, &filter);
+}
+
+
+
+INIInternTable_t *ini_intern_create(bool values)
+{
+    INIInternTable_t *table = calloc(1, sizeof(INIInternTable_t));
+    if (table) table->values = values;
+    return table;
+}
+
+
+
+size_t ini_intern_size(const INIInternTable_t *table)
+{
+    assert(table);
+    return table ? table->size : 0;
+}
+
+
+
+void ini_intern_free(INIInternTable_t *table)
+{
+    if (!table) return;
+    while (table->chunks)
+    {
+        struct INIInternChunk *next = table->chunks->next;
+        free(table->chunks);
+        table->chunks = next;
+    }
+    free(table->slots);
+    free(table);
+}
+
+
+
+INIData_t *ini_parse_file_interned(FILE *file, INIInternTable_t *table)
+{
+    assert(table);
+    if (!file || !table) return NULL;
+    return parse_file_(file, NULL, NULL, table);
+}
+
+
+
+/*
+ * Parses `length` bytes of `buffer` line by line, with lines
+ * ending after each newline. See parse_line_() for `in_place`.
+ */
+static void parse_buffer_(INIData_t *data, const char *buffer, size_t length, bool in_place)
+{
+    INISection_t *current_section = NULL;
+    const char *line = buffer;
+    const char *const end = buffer + length;
+    while (line < end)
+    {
+        const char *newline = memchr(line, '\n', end - line);
+        const char *line_end = newline ? newline + 1 : end;
+        const INILineStatus_t status = parse_line_(data, &current_section, line, line_end - line, in_place);
+        if (status == LINE_OUT_OF_MEMORY)
+            set_parse_error_(data, line, line_end - line, "Out of memory.");
+        if (status != LINE_OK)
+        {
+            free_data_sections_(data);
+            free_data_buffer_(data);
+            return;
+        }
+        line = line_end;
+    }
+}
+
+
+
+/*
+ * Loads the whole file into a heap buffer. Used when the file cannot
+ * be mapped with a trailing null byte.
+ */
+static char *read_file_(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    size_t allocation = 4096;
+    size_t used = 0;
+    char *buffer = malloc(allocation);
+    while (buffer)
+    {
+        used += fread(buffer + used, 1, allocation - used - 1, file);
+        if (used < allocation - 1) break;
+        allocation *= 2;
+        char *re = realloc(buffer, allocation);
+        if (!re) free(buffer);
+        buffer = re;
+    }
+    fclose(file);
+
+    if (!buffer) return NULL;
+    buffer[used] = '\0';
+    *size = used;
+    return buffer;
+}
+
+
+
+/*
+ * Maps a file privately and writably, or reads it into a heap buffer
+ * where that is not possible. Either way, the byte after the contents
+ * exists and is zero. Terminating strings in place copies the pages
+ * they are on, see ini_parse_mapped().
+ */
+static char *load_file_(const char *path, size_t *size, bool *mapped)
+{
+    char *begin = NULL;
+    *size = 0;
+    *mapped = false;
+
+#ifdef INI_USE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+
+    // Strings are terminated in place, so the byte after the last one
+    // must exist. Past the end of the file, the final page is zero-filled;
+    // if the file fills its last page exactly, there is no such byte.
+    const long page_size = sysconf(_SC_PAGESIZE);
+    if (*size > 0 && page_size > 0 && *size % (size_t)page_size != 0)
+    {
+        void *map = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, *size, MADV_SEQUENTIAL);
+            begin = map;
+            *mapped = true;
+        }
+    }
+    close(fd);
+#endif
+
+    if (!*mapped) begin = read_file_(path, size);
+    return begin;
+}
+
+
+
+// Creates a document that owns the contents loaded by load_file_().
+static INIData_t *create_loaded_data_(char *begin, size_t size, bool mapped)
+{
+    INIData_t *data = create_data_(NULL);
+    if (!data)
+    {
+#ifdef INI_USE_MMAP
+        if (mapped) munmap(begin, size);
+        else
+#endif
+            free(begin);
+        return NULL;
+    }
+    data->buffer.begin = begin;
+    data->buffer.size = size;
+    data->buffer.mapped = mapped;
+    return data;
+}
+
+
+
+INIData_t *ini_parse_mapped(const char *path)
+{
+    if (!path) return NULL;
+
+    size_t size;
+    bool mapped;
+    char *begin = load_file_(path, &size, &mapped);
+    if (!begin) return NULL;
+
+    INIData_t *data = create_loaded_data_(begin, size, mapped);
+    if (data) parse_buffer_(data, begin, size, true);
+    return data;
+}
+
+
+
+INIData_t *ini_parse_buffer(const char *buffer, size_t length)
+{
+    if (!buffer && length) return NULL;
+
+    INIData_t *data = create_data_(NULL);
+    if (!data) return NULL;
+    parse_buffer_(data, buffer, length, false);
+    return data;
+}
+
+
+
+// Returns the start of the first line in [c, end) that opens a section, or `end`.
+static const char *find_section_line_(const char *c, const char *end)
+{
+    while (c < end)
+    {
+        const char *first = c;
+        while (first < end && *first != '\n' && in_classes_(*first, IGNORED_CLASSES)) first++;
+        if (first < end && *first == '[') return c;
+        const char *newline = memchr(c, '\n', end - c);
+        if (!newline) break;
+        c = newline + 1;
+    }
+    return end;
+}
+
+
+
+/*
+ * Parses the lines of a section of a lazily parsed document. An
+ * error leaves the section without pairs and is only recorded if
+ * it is the first.
+ */
+static bool load_section_(INIData_t *data, INISection_t *section)
+{
+    char *const pending = section->pending;
+    const char *const end = pending + section->pending_length;
+    section->pending = NULL;
+    section->pending_length = 0;
+
+    // Once there is an error, later ones go to a copy of the document.
+    INIData_t scratch;
+    INIData_t *target = data;
+    if (data->error.encountered)
+    {
+        scratch = *data;
+        target = &scratch;
+    }
+
+    INISection_t *current_section = section;
+    const char *line = pending;
+    while (line < end)
+    {
+        const char *newline = memchr(line, '\n', end - line);
+        const char *line_end = newline ? newline + 1 : end;
+        const INILineStatus_t status = parse_line_(target, &current_section, line, line_end - line, true);
+        if (status == LINE_OK)
+        {
+            line = line_end;
+            continue;
+        }
+
+        if (status == LINE_OUT_OF_MEMORY) set_parse_error_(target, line, line_end - line, "Out of memory.");
+        section->pair_count = 0;
+        deallocate_(section->arena, section->index);
+        section->index = NULL;
+        section->index_capacity = 0;
+        return false;
+    }
+    return true;
+}
+
+
+
+// Lookups go through a const document, but parsing a pending section does not change what it holds.
+static INISection_t *loaded_section_(const INIData_t *data, INISection_t *section)
+{
+    if (section && section->pending) load_section_((INIData_t *)data, section);
+    return section;
+}
+
+
+
+/*
+ * Parses the section headers of the buffer of `data`, leaving the
+ * lines in between pending. Lines before the first section are
+ * parsed right away, as they can only be blank or an error.
+ */
+static void parse_headers_(INIData_t *data)
+{
+    char *const end = data->buffer.begin + data->buffer.size;
+    char *line = data->buffer.begin;
+    INISection_t *current_section = NULL;
+    while (line < end)
+    {
+        char *header = (char *)find_section_line_(line, end);
+        if (!current_section)
+            parse_buffer_(data, line, header - line, true);
+        else
+        {
+            current_section->pending = line;
+            current_section->pending_length = header - line;
+        }
+        if (data->error.encountered || header == end) return;
+
+        char *newline = memchr(header, '\n', end - header);
+        line = newline ? newline + 1 : end;
+        const INILineStatus_t status = parse_line_(data, &current_section, header, line - header, true);
+        if (status == LINE_OUT_OF_MEMORY)
+            set_parse_error_(data, header, line - header, "Out of memory.");
+        if (status != LINE_OK)
+        {
+            free_data_sections_(data);
+            free_data_buffer_(data);
+            return;
+        }
+    }
+}
+
+
+
+INIData_t *ini_parse_lazy(const char *path)
+{
+    if (!path) return NULL;
+
+    size_t size;
+    bool mapped;
+    char *begin = load_file_(path, &size, &mapped);
+    if (!begin) return NULL;
+
+    INIData_t *data = create_loaded_data_(begin, size, mapped);
+    if (data) parse_headers_(data);
+    return data;
+}
+
+
+
+bool ini_load_sections(INIData_t *data)
+{
+    assert(data);
+    if (!data) return false;
+
+    for (size_t i = 0; i < data->section_count; i++)
+        loaded_section_(data, section_at_(data, i));
+    return !data->error.encountered;
+}
+
+
+
+/*
+ * A run of whole sections parsed on its own. Unlike parse_buffer_(),
+ * a chunk keeps the sections it parsed before an error, since one of
+ * them may duplicate a section of an earlier chunk, which is the
+ * error to report. `headers` holds the header line of each of them,
+ * since lines parsed in place can no longer be split and tokenized.
+ */
+typedef struct
+{
+    const char *begin;
+    size_t length;
+    bool in_place;
+    INIData_t *data;
+    INIView_t *headers;
+    size_t header_capacity;
+} INIChunk_t;
+
+
+
+// Records the header line of the newest section of `chunk`.
+static bool add_chunk_header_(INIChunk_t *chunk, const char *line, size_t length)
+{
+    const size_t count = chunk->data->section_count;
+    if (count > chunk->header_capacity)
+    {
+        const size_t capacity = chunk->header_capacity ? chunk->header_capacity * 2 : INITIAL_INDEX_CAPACITY;
+        INIView_t *headers = realloc(chunk->headers, sizeof(INIView_t) * capacity);
+        if (!headers) return false;
+        chunk->headers = headers;
+        chunk->header_capacity = capacity;
+    }
+    chunk->headers[count - 1].ptr = line;
+    chunk->headers[count - 1].length = length;
+    return true;
+}
+
+
+
+static void *parse_chunk_(void *arg)
+{
+    INIChunk_t *chunk = arg;
+    chunk->data = create_data_(NULL);
+    if (!chunk->data) return NULL;
+
+    INISection_t *current_section = NULL;
+    const char *line = chunk->begin;
+    const char *const end = chunk->begin + chunk->length;
+    while (line < end)
+    {
+        const char *newline = memchr(line, '\n', end - line);
+        const char *line_end = newline ? newline + 1 : end;
+        const size_t section_count = chunk->data->section_count;
+        INILineStatus_t status = parse_line_(chunk->data, &current_section, line, line_end - line, chunk->in_place);
+        if (status == LINE_OK && chunk->data->section_count != section_count
+            && !add_chunk_header_(chunk, line, line_end - line))
+            status = LINE_OUT_OF_MEMORY;
+        if (status == LINE_OUT_OF_MEMORY)
+            set_parse_error_(chunk->data, line, line_end - line, "Out of memory.");
+        if (status != LINE_OK) break;
+        line = line_end;
+    }
+    return NULL;
+}
+
+
+
+static void free_chunk_(INIChunk_t *chunk)
+{
+    free_data_sections_(chunk->data);
+    free(chunk->data);
+    free(chunk->headers);
+    chunk->data = NULL;
+    chunk->headers = NULL;
+    chunk->header_capacity = 0;
+}
+
+
+
+// Reports a duplicate of the `number`th section of `chunk`. Header lines are never written to by in-place parsing.
+static void report_duplicate_(INIData_t *data, const INIChunk_t *chunk, size_t number)
+{
+    const INIView_t line = chunk->headers[number];
+    INIView_t first, second;
+    tokenize_line_(line.ptr, line.length, &first, &second, &data->error.offset);
+
+    char buffer[INI_MAX_LINE_SIZE];
+    snprintf(buffer, INI_MAX_LINE_SIZE, "Duplicate section '%.*s'.", (int)first.length, first.ptr);
+    set_parse_error_(data, line.ptr, line.length, buffer);
+}
+
+
+
+/*
+ * Moves the sections of a parsed chunk to the end of `data`, which
+ * takes over their storage, and frees the chunk. Returns false if
+ * that, or the chunk itself, ran into an error, which is then
+ * recorded in `data`.
+ */
+static bool merge_chunk_(INIData_t *data, INIChunk_t *chunk)
+{
+    INIData_t *const source = chunk->data;
+    if (!source)
+    {
+        set_parse_error_(data, chunk->begin, 0, "Out of memory.");
+        free_chunk_(chunk);
+        return false;
+    }
+
+    bool merged = true;
+    for (size_t i = 0; i < source->section_count; i++)
+    {
+        INISection_t *section = section_at_(source, i);
+        if (find_section_(data, section->name, section->name_length))
+        {
+            report_duplicate_(data, chunk, i);
+            merged = false;
+            break;
+        }
+
+        INISection_t *slot = section_slot_(data, data->section_count);
+        if (!slot)
+        {
+            set_parse_error_(data, chunk->begin, 0, "Out of memory.");
+            merged = false;
+            break;
+        }
+        *slot = *section;
+        data->section_count++;
+        index_section_(data, data->section_count);
+        memset(section, 0, sizeof(*section));
+    }
+
+    if (merged && source->error.encountered)
+    {
+        data->error = source->error;
+        merged = false;
+    }
+    free_chunk_(chunk);
+    return merged;
+}
+
+
+
+/*
+ * Splits [buffer, buffer + length) at section headers into about
+ * `threads` chunks, parses them concurrently and appends their
+ * sections to `data` in file order.
+ */
+static void parse_parallel_(INIData_t *data, const char *buffer, size_t length, bool in_place, unsigned threads)
+{
+#ifdef INI_USE_THREADS
+    if (threads == 0)
+    {
+        const long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned)online : 1;
+    }
+#else
+    threads = 1;
+#endif
+    size_t chunk_count = length / MIN_PARALLEL_CHUNK_SIZE + 1;
+    if (chunk_count > threads) chunk_count = threads;
+    if (chunk_count > MAX_PARALLEL_CHUNKS) chunk_count = MAX_PARALLEL_CHUNKS;
+
+    INIChunk_t chunks[MAX_PARALLEL_CHUNKS];
+    const char *const end = buffer + length;
+    const char *begin = buffer;
+    size_t count = 0;
+    for (size_t i = 1; i <= chunk_count && begin < end; i++)
+    {
+        const char *split = end;
+        if (i < chunk_count)
+        {
+            const char *target = buffer + length / chunk_count * i;
+            if (target < begin) target = begin;
+            const char *newline = memchr(target, '\n', end - target);
+            split = newline ? find_section_line_(newline + 1, end) : end;
+        }
+        const INIChunk_t chunk = {begin, (size_t)(split - begin), in_place, NULL, NULL, 0};
+        chunks[count++] = chunk;
+        begin = split;
+    }
+
+#ifdef INI_USE_THREADS
+    pthread_t workers[MAX_PARALLEL_CHUNKS];
+    bool started[MAX_PARALLEL_CHUNKS] = {false};
+    for (size_t i = 1; i < count; i++)
+        started[i] = pthread_create(&workers[i], NULL, parse_chunk_, &chunks[i]) == 0;
+    if (count) parse_chunk_(&chunks[0]);
+    for (size_t i = 1; i < count; i++)
+    {
+        if (started[i]) pthread_join(workers[i], NULL);
+        else parse_chunk_(&chunks[i]);
+    }
+#else
+    for (size_t i = 0; i < count; i++) parse_chunk_(&chunks[i]);
+#endif
+
+    bool merged = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (merged)
+        {
+            merged = merge_chunk_(data, &chunks[i]);
+            continue;
+        }
+        free_chunk_(&chunks[i]);
+    }
+    if (!merged)
+    {
+        free_data_sections_(data);
+        free_data_buffer_(data);
+    }
+}
+
+
+
+INIData_t *ini_parse_buffer_parallel(const char *buffer, size_t length, unsigned threads)
+{
+    if (!buffer && length) return NULL;
+
+    INIData_t *data = create_data_(NULL);
+    if (!data) return NULL;
+    parse_parallel_(data, buffer, length, false, threads);
+    return data;
+}
+
+
+
+INIData_t *ini_parse_mapped_parallel(const char *path, unsigned threads)
+{
+    if (!path) return NULL;
+
+    size_t size;
+    bool mapped;
+    char *begin = load_file_(path, &size, &mapped);
+    if (!begin) return NULL;
+
+    INIData_t *data = create_loaded_data_(begin, size, mapped);
+    if (data) parse_parallel_(data, begin, size, true, threads);
+    return data;
+}
+
+
+
+/*
+ * Reports a single line to `handler`. `section` holds the name of the
+ * current section and is updated when a new one starts; `storage`, if
+ * provided, is a heap buffer of `*capacity` bytes that receives a copy
+ * of the name so that it outlives the line, and grows to fit it.
+ */
+static bool dispatch_line_(const INIHandler_t *handler, void *user, const char *line, size_t length,
+                           INIView_t *section, char **storage, size_t *capacity)
+{
+    INIView_t first, second;
+    ptrdiff_t error_offset;
+    const char *msg = NULL;
+    switch (tokenize_line_(line, length, &first, &second, &error_offset))
+    {
+        case TOKEN_BLANK:
+            return true;
+
+        case TOKEN_PAIR:
+            if (!section->ptr)
+            {
+                msg = MISSING_SECTION_MESSAGE;
+                break;
+            }
+            return !handler->on_pair || handler->on_pair(user, *section, first, second);
+
+        case TOKEN_SECTION:
+            if (storage)
+            {
+                if (first.length > *capacity)
+                {
+                    char *grown = realloc(*storage, first.length);
+                    if (!grown)
+                    {
+                        error_offset = 0;
+                        msg = "Out of memory.";
+                        break;
+                    }
+                    *storage = grown;
+                    *capacity = first.length;
+                }
+                memcpy(*storage, first.ptr, first.length);
+                first.ptr = *storage;
+            }
+            *section = first;
+            return !handler->on_section || handler->on_section(user, first);
+
+        case TOKEN_BAD_PAIR:
+            msg = BAD_PAIR_MESSAGE;
+            break;
+
+        case TOKEN_BAD_SECTION:
+            msg = BAD_SECTION_MESSAGE;
+            break;
+    }
+
+    if (handler->on_error)
+    {
+        const INIView_t line_view = {line, length};
+        handler->on_error(user, line_view, error_offset, msg);
+    }
+    return false;
+}
+
+
+
+bool ini_parse_events(FILE *file, const INIHandler_t *handler, void *user)
+{
+    assert(handler);
+    if (!file || !handler) return false;
+
+    char *line = NULL;
+    size_t capacity = 0;
+    size_t length;
+    char *section_name = NULL;
+    size_t section_capacity = 0;
+    INIView_t section = {NULL, 0};
+    bool parsed = true;
+    while (parsed && read_line_(file, &line, &capacity, &length))
+        parsed = dispatch_line_(handler, user, line, length, &section, &section_name, &section_capacity);
+    free(section_name);
+    free(line);
+    return parsed && (feof(file) || ferror(file));
+}
+
+
+
+bool ini_parse_events_buffer(const char *buffer, size_t length, const INIHandler_t *handler, void *user)
+{
+    assert(handler);
+    if ((!buffer && length) || !handler) return false;
+
+    INIView_t section = {NULL, 0};
+    const char *line = buffer;
+    const char *const end = buffer + length;
+    while (line < end)
+    {
+        const char *newline = memchr(line, '\n', end - line);
+        const char *line_end = newline ? newline + 1 : end;
+        if (!dispatch_line_(handler, user, line, line_end - line, &section, NULL, NULL))
+            return false;
+        line = line_end;
+    }
+    return true;
+}
+
+
+
+INISection_t *ini_has_section(const INIData_t *data, const char *section)
+{
+    if (!data || !section) return NULL;
+    return loaded_section_(data, find_section_(data, section, strlen(section)));
+}
+
+
+
+INISection_t *ini_section_at(const INIData_t *data, size_t index)
+{
+    assert(data);
+    if (!data || index >= data->section_count) return NULL;
+    return loaded_section_(data, section_at_(data, index));
+}
+
+
+
+INIEntry_t *ini_pair_at(const INISection_t *section, size_t index)
+{
+    assert(section);
+    if (!section || index >= section->pair_count) return NULL;
+    return pair_at_(section, index);
+}
+
+
+
+void ini_section_init(const char *name, INISection_t *section)
+{
+    assert(section);
+    if (!section) return;
+    section_init_(NULL, section);
+    if (name) store_section_name_(section, name, strlen(name));
+}
+
+
+
+// Called for structural changes made through the document, skipping zero on wrap-around.
+static void advance_generation_(INIData_t *data)
+{
+    if (++data->generation == 0) data->generation = 1;
+}
+
+
+
+INISection_t *ini_add_section(INIData_t *data, const char *name)
+{
+    if (!name || ini_has_section(data, name)) return NULL;
+    INISection_t *section = add_section_(data, name, strlen(name));
+    if (section) advance_generation_(data);
+    return section;
+}
+
+
+
+INIEntry_t *ini_add_pair(INIData_t *data, const char *section, const INIPair_t pair)
+{
+    INISection_t *existing_section = ini_has_section(data, section);
+    if (!existing_section) return NULL;
+    INIEntry_t *entry = ini_add_pair_to_section(existing_section, pair);
+    if (entry) advance_generation_(data);
+    return entry;
+}
+
+
+
+INIEntry_t *ini_add_pair_to_section(INISection_t *section, const INIPair_t pair)
+{
+    assert(section);
+    if (!section) return NULL;
+
+    const INIView_t key = {pair.key, strnlen(pair.key, INI_MAX_STRING_SIZE)};
+    const INIView_t value = {pair.value, strnlen(pair.value, INI_MAX_STRING_SIZE)};
+    return copy_entry_(section, key, value);
+}
+
+
+
+static INIEntry_t *lookup_entry_(const INIData_t *data, const char *section, const char *key)
+{
+    if (!data || !section || !key) return NULL;
+
+    const INISection_t *found_section = ini_has_section(data, section);
+    if (!found_section) return NULL;
+
+    return find_entry_(found_section, key, strlen(key));
+}
+
+
+
+INIEntry_t *ini_emplace_pair(INIData_t *data, const char *section, INIView_t key, INIView_t value)
+{
+    INISection_t *existing_section = ini_has_section(data, section);
+    if (!existing_section) return NULL;
+    INIEntry_t *entry = ini_emplace_pair_to_section(existing_section, key, value);
+    if (entry) advance_generation_(data);
+    return entry;
+}
+
+
+
+INIEntry_t *ini_emplace_pair_to_section(INISection_t *section, INIView_t key, INIView_t value)
+{
+    assert(section);
+    assert(key.ptr || !key.length);
+    assert(value.ptr || !value.length);
+    if (!section || (!key.ptr && key.length) || (!value.ptr && value.length)) return NULL;
+    return copy_entry_(section, key, value);
+}
+
+
+
+const char *ini_get_value(const INIData_t *data, const char *section, const char *key)
+{
+    assert(data);
+    assert(section);
+    assert(key);
+
+    const INIEntry_t *entry = lookup_entry_(data, section, key);
+    return entry ? entry->value : NULL;
+}
+
+
+
+// A section name from a batch of queries and the section it resolved to.
+struct INIQuerySection
+{
+    const char *name;
+    const INISection_t *section;
+};
+
+
+
+static size_t hash_pointer_(const void *pointer)
+{
+    uint64_t bits = (uint64_t)(uintptr_t)pointer;
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return (size_t)bits;
+}
+
+
+
+size_t ini_get_values(const INIData_t *data, const INIQuery_t *queries, size_t n, const char **out)
+{
+    assert(data);
+    assert(queries || !n);
+    assert(out || !n);
+    if (!data || !queries || !out) return 0;
+
+    /*
+     * Each distinct section name is resolved once, wherever its queries
+     * sit in the batch, by remembering the sections already looked up in
+     * a table keyed by the name's address. Without room for the table,
+     * only neighbouring queries for the same section share a lookup.
+     */
+    struct INIQuerySection stack[QUERY_STACK_SIZE];
+    size_t capacity = 8;
+    while (capacity < 2 * n) capacity *= 2;
+    struct INIQuerySection *seen = capacity <= QUERY_STACK_SIZE ? stack : malloc(capacity * sizeof(*seen));
+    if (seen) memset(seen, 0, capacity * sizeof(*seen));
+
+    size_t found = 0;
+    const char *name = NULL;
+    const INISection_t *section = NULL;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = NULL;
+        if (!queries[i].section || !queries[i].key) continue;
+
+        if (queries[i].section != name)
+        {
+            name = queries[i].section;
+            size_t slot = hash_pointer_(name) & (capacity - 1);
+            while (seen && seen[slot].name && seen[slot].name != name)
+                slot = (slot + 1) & (capacity - 1);
+            if (seen && seen[slot].name)
+            {
+                section = seen[slot].section;
+            }
+            else
+            {
+                section = ini_has_section(data, name);
+                if (seen) seen[slot] = (struct INIQuerySection){name, section};
+            }
+        }
+        const INIEntry_t *entry = section ? find_entry_(section, queries[i].key, strlen(queries[i].key)) : NULL;
+        if (!entry) continue;
+        out[i] = entry->value;
+        found++;
+    }
+
+    if (seen != stack) free(seen);
+    return found;
+}
+
+
+
+/*
+ * Typed values are checked character by character rather than with
+ * <ctype.h> and strtol(), whose behavior follows the locale, so that
+ * a value converts the same way in any locale.
+ */
+static unsigned digit_value_(char c)
+{
+    if (c >= '0' && c <= '9') return (unsigned)(c - '0');
+    if (c >= 'a' && c <= 'f') return (unsigned)(c - 'a' + 10);
+    if (c >= 'A' && c <= 'F') return (unsigned)(c - 'A' + 10);
+    return 16;
+}
+
+
+
+// Returns the end of the digits starting at `c`, or NULL if there are none or they overflow.
+static const char *parse_digits_(const char *c, unsigned base, unsigned long long *value)
+{
+    const char *const begin = c;
+    *value = 0;
+    for (unsigned digit; (digit = digit_value_(*c)) < base; c++)
+    {
+        if (*value > (ULLONG_MAX - digit) / base) return NULL;
+        *value = *value * base + digit;
+    }
+    return c == begin ? NULL : c;
+}
+
+
+
+static const char *skip_digits_(const char *c)
+{
+    while (in_classes_(*c, CLASS_BIT_(CLASS_DIGIT))) c++;
+    return c;
+}
+
+
+
+static bool parse_int_(const char *str, long long *value)
+{
+    const bool negative = *str == '-';
+    const char *digits = str + (*str == '-' || *str == '+');
+    const unsigned base = digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X') ? 16 : 10;
+    if (base == 16) digits += 2;
+
+    unsigned long long magnitude;
+    const char *end = parse_digits_(digits, base, &magnitude);
+    if (!end || *end != '\0') return false;
+    if (magnitude > (negative ? (unsigned long long)LLONG_MAX + 1 : (unsigned long long)LLONG_MAX)) return false;
+
+    *value = negative ? (magnitude ? -(long long)(magnitude - 1) - 1 : 0) : (long long)magnitude;
+    return true;
+}
+
+
+
+/*
+ * Only the decimal point is taken from the locale: the number is
+ * checked by hand, and its '.' is swapped for the decimal point that
+ * strtod() expects before it is converted.
+ */
+static bool parse_double_(const char *str, double *value)
+{
+    const char *c = str + (*str == '-' || *str == '+');
+    const char *const integer = c;
+    c = skip_digits_(c);
+    size_t digit_count = (size_t)(c - integer);
+    const char *point = NULL;
+    if (*c == '.')
+    {
+        point = c++;
+        const char *const fraction = c;
+        c = skip_digits_(c);
+        digit_count += (size_t)(c - fraction);
+    }
+    if (!digit_count) return false;
+    if (*c == 'e' || *c == 'E')
+    {
+        c++;
+        c += *c == '-' || *c == '+';
+        const char *const exponent = c;
+        c = skip_digits_(c);
+        if (c == exponent) return false;
+    }
+    if (*c != '\0') return false;
+
+    const char *radix = localeconv()->decimal_point;
+    const size_t radix_length = strlen(radix);
+    char local[64];
+    char *copy = NULL;
+    const char *number = str;
+    if (point && strcmp(radix, ".") != 0)
+    {
+        // The copy includes the null terminator at `c`.
+        const size_t length = (size_t)(c - str) + radix_length;
+        copy = length <= sizeof(local) ? local : malloc(length);
+        if (!copy) return false;
+        memcpy(copy, str, (size_t)(point - str));
+        memcpy(copy + (point - str), radix, radix_length);
+        memcpy(copy + (point - str) + radix_length, point + 1, (size_t)(c - point));
+        number = copy;
+    }
+
+    char *end;
+    errno = 0;
+    *value = strtod(number, &end);
+    const bool valid = *end == '\0' && errno != ERANGE;
+    if (copy != local) free(copy);
+    return valid;
+}
+
+
+
+static bool equals_ignoring_case_(const char *str, const char *lower)
+{
+    for (; *str && *lower; str++, lower++)
+    {
+        const char c = *str >= 'A' && *str <= 'Z' ? (char)(*str - 'A' + 'a') : *str;
+        if (c != *lower) return false;
+    }
+    return *str == *lower;
 }
 
 
 
-static void free_data_sections_(INIData_t *data)
+static bool parse_bool_(const char *str, bool *value)
 {
-    if (data)
+    static const char *const truthy[] = {"true", "yes", "on", "1"};
+    static const char *const falsy[] = {"false", "no", "off", "0"};
+    for (size_t i = 0; i < sizeof(truthy) / sizeof(truthy[0]); i++)
     {
-        if (data->sections)
+        if (equals_ignoring_case_(str, truthy[i]) || equals_ignoring_case_(str, falsy[i]))
         {
-            for (int i = 0; i < data->section_count; i++)
-                if (data->sections[i].pairs)
-                    free(data->sections[i].pairs);
-            free(data->sections);
+            *value = equals_ignoring_case_(str, truthy[i]);
+            return true;
         }
-        data->sections = NULL;
     }
+    return false;
 }
 
 
 
+static bool parse_size_(const char *str, size_t *value)
+{
+    unsigned long long count;
+    const char *end = parse_digits_(str, 10, &count);
+    if (!end || count > SIZE_MAX) return false;
 
-INIData_t *ini_parse_file(FILE *file)
+    unsigned shift = 0;
+    switch (*end)
+    {
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        case 't': case 'T': shift = 40; end++; break;
+        default: break;
+    }
+    if (*end == 'b' || *end == 'B') end++;
+    if (*end != '\0' || shift >= sizeof(size_t) * 8 || count > (SIZE_MAX >> shift)) return false;
+
+    *value = (size_t)count << shift;
+    return true;
+}
+
+
+
+// Converts the value of `entry` to `type` unless the cache already holds that conversion.
+static bool convert_entry_(INIEntry_t *entry, INICacheType_t type)
 {
-    if (!file) return NULL;
+    if (entry->cache.type == type) return entry->cache.valid;
 
-    INIData_t *data = malloc(sizeof(INIData_t));
-    assert(data);
-    if (!data) return NULL;
+    bool valid = false;
+    switch (type)
+    {
+        case CACHE_INT: valid = parse_int_(entry->value, &entry->cache.as.integer); break;
+        case CACHE_DOUBLE: valid = parse_double_(entry->value, &entry->cache.as.real); break;
+        case CACHE_BOOL: valid = parse_bool_(entry->value, &entry->cache.as.boolean); break;
+        case CACHE_SIZE: valid = parse_size_(entry->value, &entry->cache.as.size); break;
+        case CACHE_NONE: break;
+    }
+    entry->cache.type = type;
+    entry->cache.valid = valid;
+    return valid;
+}
 
-    data->error.encountered = false;
-    memset(data->error.line, 0, sizeof(data->error.line));
-    data->error.offset = 0;
-    data->section_count = 0;
-    data->section_allocation = INITIAL_ALLOCATED_SECTIONS;
-    data->sections = malloc(sizeof(INISection_t) * data->section_allocation);
 
-    char line[INI_MAX_LINE_SIZE];
-    INISection_t *current_section = NULL;
-    while (fgets(line, INI_MAX_LINE_SIZE, file))
+
+bool ini_get_int(INIData_t *data, const char *section, const char *key, long long *value)
+{
+    assert(value);
+    INIEntry_t *entry = lookup_entry_(data, section, key);
+    if (!entry || !value || !convert_entry_(entry, CACHE_INT)) return false;
+    *value = entry->cache.as.integer;
+    return true;
+}
+
+
+
+bool ini_get_double(INIData_t *data, const char *section, const char *key, double *value)
+{
+    assert(value);
+    INIEntry_t *entry = lookup_entry_(data, section, key);
+    if (!entry || !value || !convert_entry_(entry, CACHE_DOUBLE)) return false;
+    *value = entry->cache.as.real;
+    return true;
+}
+
+
+
+bool ini_get_bool(INIData_t *data, const char *section, const char *key, bool *value)
+{
+    assert(value);
+    INIEntry_t *entry = lookup_entry_(data, section, key);
+    if (!entry || !value || !convert_entry_(entry, CACHE_BOOL)) return false;
+    *value = entry->cache.as.boolean;
+    return true;
+}
+
+
+
+bool ini_get_size(INIData_t *data, const char *section, const char *key, size_t *value)
+{
+    assert(value);
+    INIEntry_t *entry = lookup_entry_(data, section, key);
+    if (!entry || !value || !convert_entry_(entry, CACHE_SIZE)) return false;
+    *value = entry->cache.as.size;
+    return true;
+}
+
+
+
+INIEntry_t *ini_set_value(INIData_t *data, const char *section, const char *key, const char *value)
+{
+    assert(value);
+    if (!data || !section || !key || !value) return NULL;
+
+    INISection_t *found_section = ini_has_section(data, section);
+    INIEntry_t *entry = found_section ? find_entry_(found_section, key, strlen(key)) : NULL;
+    if (!entry) return NULL;
+
+    const size_t length = strlen(value);
+    const char *copy = store_value_(found_section, value, length);
+    if (!copy) return NULL;
+
+    entry->value = copy;
+    entry->value_length = length;
+    entry->cache.type = CACHE_NONE;
+    return entry;
+}
+
+
+
+// Converts an entry to `type` and stores the result at `field`.
+static bool bind_entry_(INIEntry_t *entry, INIBindType_t type, void *field)
+{
+    switch (type)
+    {
+        case INI_BIND_STRING:
+            memcpy(field, &entry->value, sizeof(entry->value));
+            return true;
+
+        case INI_BIND_INT:
+            if (!convert_entry_(entry, CACHE_INT)) return false;
+            memcpy(field, &entry->cache.as.integer, sizeof(entry->cache.as.integer));
+            return true;
+
+        case INI_BIND_DOUBLE:
+            if (!convert_entry_(entry, CACHE_DOUBLE)) return false;
+            memcpy(field, &entry->cache.as.real, sizeof(entry->cache.as.real));
+            return true;
+
+        case INI_BIND_BOOL:
+            if (!convert_entry_(entry, CACHE_BOOL)) return false;
+            memcpy(field, &entry->cache.as.boolean, sizeof(entry->cache.as.boolean));
+            return true;
+
+        case INI_BIND_SIZE:
+            if (!convert_entry_(entry, CACHE_SIZE)) return false;
+            memcpy(field, &entry->cache.as.size, sizeof(entry->cache.as.size));
+            return true;
+    }
+    return false;
+}
+
+
+
+size_t ini_bind(INIData_t *data, const INIBinding_t *bindings, size_t count, void *object, INIBindStatus_t *status)
+{
+    assert(data);
+    assert(bindings || !count);
+    assert(object);
+    if (!data || !bindings || !object) return count;
+
+    size_t failed = 0;
+    const char *name = NULL;
+    INISection_t *section = NULL;
+    for (size_t i = 0; i < count; i++)
     {
-        // Blank line?
-        if (ini_is_blank_line(line)) continue;
+        const INIBinding_t *binding = &bindings[i];
+        void *field = (char *)object + binding->offset;
 
-        // Pair?
-        INIPair_t pair;
-        if (ini_parse_pair(line, &pair, &data->error.offset))
+        // Consecutive bindings for the same section share one section lookup.
+        if (binding->section && (!name || (binding->section != name && strcmp(binding->section, name) != 0)))
         {
-            if (!current_section)
-            {
-                set_parse_error_(data, line, "Pairs must reside within a section.");
-                goto parse_failure;
-            }
-            ini_add_pair_to_section(current_section, pair);
-            continue;
+            name = binding->section;
+            section = ini_has_section(data, name);
         }
+        INIEntry_t *entry = binding->section && binding->key && section
+                                ? find_entry_(section, binding->key, strlen(binding->key))
+                                : NULL;
 
-        // It's not a pair... is it a section?
-        if (line[data->error.offset] != '[')
+        INIBindStatus_t result = INI_BIND_OK;
+        if (entry)
         {
-            set_parse_error_(data, line, "Failed to parse pair.");
-            goto parse_failure;
+            if (!bind_entry_(entry, binding->type, field)) result = INI_BIND_INVALID;
         }
-
-        // It's a section... but is it valid?
-        INISection_t dest_section;
-        if (ini_parse_section(line, &dest_section, &data->error.offset))
+        else if (binding->fallback)
         {
-            const INISection_t *existing_section = ini_has_section(data, dest_section.name);
-            if (existing_section)
-            {
-                char buffer[INI_MAX_LINE_SIZE];
-                snprintf(buffer, INI_MAX_LINE_SIZE, "Duplicate section '%s'.", dest_section.name);
-                set_parse_error_(data, line, buffer);
-                goto parse_failure;
-            }
-            current_section = ini_add_section(data, dest_section.name);
-            continue;
+            INIEntry_t fallback = {NULL, binding->fallback, 0, strlen(binding->fallback), {CACHE_NONE, false, {0}}};
+            if (!bind_entry_(&fallback, binding->type, field)) result = INI_BIND_INVALID;
         }
+        else
+            result = INI_BIND_MISSING;
 
-        // It's not a valid section
-        set_parse_error_(data, line, "Failed to parse section.");
-        goto parse_failure;
+        if (result != INI_BIND_OK) failed++;
+        if (status) status[i] = result;
     }
-    return data;
+    return failed;
+}
 
-    parse_failure:
-    free_data_sections_(data);
-    return data;
 
+
+INIHandle_t ini_resolve(const INIData_t *data, const char *section, const char *key)
+{
+    assert(data);
+    assert(section);
+    assert(key);
+
+    INIHandle_t handle = {0, 0, 0};
+    if (!data || !section || !key) return handle;
+
+    const INISection_t *found_section = ini_has_section(data, section);
+    const INIEntry_t *entry = found_section ? find_entry_(found_section, key, strlen(key)) : NULL;
+    if (!entry) return handle;
+
+    handle.section = section_position_(data, found_section);
+    handle.pair = pair_position_(found_section, entry);
+    handle.generation = data->generation;
+    return handle;
 }
 
 
 
-void ini_write_file(const INIData_t *data, FILE *file)
+const char *ini_get_by_handle(const INIData_t *data, INIHandle_t handle)
 {
     assert(data);
-    assert(file);
-    if (!data || !file) return;
+    if (!data || handle.generation == 0 || handle.generation != data->generation) return NULL;
+    if (handle.section >= data->section_count) return NULL;
+
+    const INISection_t *section = section_at_(data, handle.section);
+    if (handle.pair >= section->pair_count) return NULL;
+    return pair_at_(section, handle.pair)->value;
+}
+
 
-    for (int i = 0; i < data->section_count; i++)
+
+static uint64_t key_head_(const char *key)
+{
+    uint64_t head = 0;
+    for (int i = 0; i < 8; i++)
     {
-        const INISection_t *section = &data->sections[i];
-        fprintf(file, "[%s]\n", section->name);
-        for (int j = 0; j < section->pair_count; j++)
-            fprintf(file, "%s=%s\n", section->pairs[j].key, section->pairs[j].value);
+        head = head << 8 | (unsigned char)*key;
+        if (*key) key++;
     }
+    return head;
 }
 
 
 
-INISection_t *ini_has_section(const INIData_t *data, const char *section)
+static int compare_key_order_(const void *a, const void *b)
 {
-    if (!data || !section || !data->sections) return NULL;
-    static INIData_t *cached_data = NULL;
-    static INISection_t *cached = NULL;
-    if (cached && cached_data)
-        if (data == cached_data && strncmp(section, cached->name, INI_MAX_STRING_SIZE) == 0)
-            return cached;
-    for (int i = 0; i < data->section_count; i++)
-        if (strncmp(section, data->sections[i].name, INI_MAX_STRING_SIZE) == 0)
-        {
-            cached = &data->sections[i];
-            return cached;
-        }
-    return NULL;
+    const struct INIKeyOrder *x = a;
+    const struct INIKeyOrder *y = b;
+    if (x->head != y->head) return x->head < y->head ? -1 : 1;
+    const int order = strcmp(x->key, y->key);
+    if (order) return order;
+    return x->position < y->position ? -1 : x->position > y->position;
 }
 
 
 
-void ini_section_init(const char *name, INISection_t *section)
+// Sorts the keys of `section` unless that has been done since its last pair was added.
+static bool order_keys_(INISection_t *section)
 {
-    assert(section);
-    if (!section) return;
-    memset(section->name, 0, INI_MAX_STRING_SIZE);
-    strncpy(section->name, name, INI_MAX_STRING_SIZE - 1);
-    section->pair_count = 0;
-    section->pairs = malloc(sizeof(INIPair_t) * INITIAL_ALLOCATED_PAIRS);
-    section->pair_allocation = INITIAL_ALLOCATED_PAIRS;
+    if (section->order && section->order_count == section->pair_count) return true;
+
+    deallocate_(section->arena, section->order);
+    section->order = NULL;
+    section->order_count = 0;
+    if (!section->pair_count) return true;
+
+    section->order = allocate_(section->arena, sizeof(struct INIKeyOrder) * section->pair_count);
+    if (!section->order) return false;
+    for (size_t i = 0; i < section->pair_count; i++)
+    {
+        const char *key = pair_at_(section, i)->key;
+        section->order[i].head = key_head_(key);
+        section->order[i].key = key;
+        section->order[i].position = i;
+    }
+    qsort(section->order, section->pair_count, sizeof(struct INIKeyOrder), compare_key_order_);
+    section->order_count = section->pair_count;
+    return true;
 }
 
 
 
-INISection_t *ini_add_section(INIData_t *data, const char *name)
+// Returns the position in the sorted keys of the first key not below `key`.
+static size_t lower_bound_(const INISection_t *section, const char *key)
 {
-    if (ini_has_section(data, name)) return NULL;
-
-    if (data->section_count >= data->section_allocation)
+    const uint64_t head = key_head_(key);
+    size_t low = 0;
+    size_t high = section->order_count;
+    while (low < high)
     {
-        data->section_allocation *= 2;
-        INISection_t *re = realloc(data->sections, sizeof(INISection_t) * data->section_allocation);
-        if (!re) return NULL;
-        data->sections = re;
+        const size_t middle = low + (high - low) / 2;
+        const struct INIKeyOrder *order = &section->order[middle];
+        if (order->head < head || (order->head == head && strcmp(order->key, key) < 0))
+            low = middle + 1;
+        else
+            high = middle;
     }
-    INISection_t *section = &data->sections[data->section_count++];
-    ini_section_init(name, section);
-    return section;
+    return low;
 }
 
 
 
-INIPair_t *ini_add_pair(INIData_t *data, const char *section, const INIPair_t pair)
+bool ini_iter_prefix(INISection_t *section, const char *prefix, INIIterator_t *iter)
 {
-    INISection_t *existing_section = ini_has_section(data, section);
-    if (!existing_section) return NULL;
-    return ini_add_pair_to_section(existing_section, pair);
+    assert(section);
+    assert(prefix);
+    assert(iter);
+    if (!section || !prefix || !iter || !order_keys_(section)) return false;
+
+    const size_t length = strlen(prefix);
+    iter->section = section;
+    iter->next = lower_bound_(section, prefix);
+    iter->end = iter->next;
+    while (iter->end < section->order_count && strncmp(section->order[iter->end].key, prefix, length) == 0)
+        iter->end++;
+    return true;
 }
 
 
 
-INIPair_t *ini_add_pair_to_section(INISection_t *section, const INIPair_t pair)
+bool ini_iter_range(INISection_t *section, const char *low, const char *high, INIIterator_t *iter)
 {
     assert(section);
-    if (!section) return NULL;
+    assert(iter);
+    if (!section || !iter || !order_keys_(section)) return false;
+
+    iter->section = section;
+    iter->next = low ? lower_bound_(section, low) : 0;
+    iter->end = high ? lower_bound_(section, high) : section->order_count;
+    if (iter->end < iter->next) iter->end = iter->next;
+    return true;
+}
+
+
 
-    if (section->pair_count >= section->pair_allocation)
+const INIEntry_t *ini_iter_next(INIIterator_t *iter)
+{
+    assert(iter);
+    if (!iter || iter->next >= iter->end) return NULL;
+
+    const INISection_t *section = iter->section;
+    if (section->order_count != section->pair_count || iter->end > section->order_count) return NULL;
+    return pair_at_(section, section->order[iter->next++].position);
+}
+
+
+
+static bool sections_equal_(const INISection_t *a, const INISection_t *b)
+{
+    if (a->pair_count != b->pair_count) return false;
+    for (size_t i = 0; i < a->pair_count; i++)
     {
-        section->pair_allocation *= 2;
-        INIPair_t *re = realloc(section->pairs, sizeof(INIPair_t) * section->pair_allocation);
-        if (!re)
-            return NULL;
-        section->pairs = re;
+        const INIEntry_t *x = pair_at_(a, i);
+        const INIEntry_t *y = pair_at_(b, i);
+        if (x->key_length != y->key_length || x->value_length != y->value_length
+            || memcmp(x->key, y->key, x->key_length) != 0 || memcmp(x->value, y->value, x->value_length) != 0)
+            return false;
     }
+    return true;
+}
+
+
+
+// Reports a section and, key by key, how its pairs differ. Either section may be NULL.
+static void report_section_(const INIDiffHandler_t *handler, void *user, const INISection_t *old_section,
+                            const INISection_t *new_section)
+{
+    if (handler->on_section) handler->on_section(user, old_section, new_section);
+    if (!handler->on_pair) return;
 
-    INIPair_t *new_pair = &section->pairs[section->pair_count++];
-    *new_pair = pair;
-    return new_pair;
+    const char *name = new_section ? new_section->name : old_section->name;
+    for (size_t i = 0; new_section && i < new_section->pair_count; i++)
+    {
+        const INIEntry_t *entry = pair_at_(new_section, i);
+        if (find_entry_(new_section, entry->key, entry->key_length) != entry) continue;
+        const INIEntry_t *old_entry = old_section ? find_entry_(old_section, entry->key, entry->key_length) : NULL;
+        if (!old_entry || old_entry->value_length != entry->value_length
+            || memcmp(old_entry->value, entry->value, entry->value_length) != 0)
+            handler->on_pair(user, name, old_entry, entry);
+    }
+    for (size_t i = 0; old_section && i < old_section->pair_count; i++)
+    {
+        const INIEntry_t *entry = pair_at_(old_section, i);
+        if (find_entry_(old_section, entry->key, entry->key_length) != entry) continue;
+        if (!new_section || !find_entry_(new_section, entry->key, entry->key_length))
+            handler->on_pair(user, name, entry, NULL);
+    }
 }
 
 
 
-const char *ini_get_value(const INIData_t *data, const char *section, const char *key)
+bool ini_apply(INIData_t *data, INIData_t *update, const INIDiffHandler_t *handler, void *user)
 {
     assert(data);
-    assert(data->sections);
-    assert(section);
-    assert(key);
+    assert(update);
+    if (!data || !update || data == update || data->error.encountered || update->error.encountered) return false;
+    // Pairs of a document with a buffer point into it, so they cannot be moved to `data`.
+    if (data->arena || update->arena || update->buffer.begin) return false;
 
-    if (!data || !section || !key || !data->sections) return NULL;
+    // Sections that were never looked up must be compared by their pairs.
+    ini_load_sections(data);
 
-    INISection_t *found_section = NULL;
-    for (int i = 0; i < data->section_count; i++)
+    bool *kept = calloc(data->section_count + 1, sizeof(bool));
+    if (!kept) return false;
+
+    // Unchanged sections trade places with their copies in the update.
+    for (size_t i = 0; i < update->section_count; i++)
     {
-        if (strncmp(data->sections[i].name, section, INI_MAX_STRING_SIZE) == 0)
-        {
-            found_section = &data->sections[i];
-            break;
-        }
+        INISection_t *section = section_at_(update, i);
+        INISection_t *old_section = find_section_(data, section->name, section->name_length);
+        if (!old_section || !sections_equal_(old_section, section)) continue;
+        const INISection_t swap = *section;
+        *section = *old_section;
+        *old_section = swap;
+        kept[section_position_(data, old_section)] = true;
     }
 
-    if (!found_section) return NULL;
-
-    for (int i = 0; i < found_section->pair_count; i++)
+    // From here on `update` holds the old sections.
+    INISection_t *section_blocks[INI_MAX_BLOCKS];
+    memcpy(section_blocks, data->section_blocks, sizeof(section_blocks));
+    const size_t section_count = data->section_count;
+    struct INIIndexSlot *const section_index = data->section_index;
+    const unsigned section_index_capacity = data->section_index_capacity;
+    memcpy(data->section_blocks, update->section_blocks, sizeof(section_blocks));
+    data->section_count = update->section_count;
+    data->section_index = update->section_index;
+    data->section_index_capacity = update->section_index_capacity;
+    memcpy(update->section_blocks, section_blocks, sizeof(section_blocks));
+    update->section_count = section_count;
+    update->section_index = section_index;
+    update->section_index_capacity = section_index_capacity;
+    advance_generation_(data);
+
+    if (handler)
     {
-        if (strncmp(found_section->pairs[i].key, key, INI_MAX_STRING_SIZE) == 0)
-            return found_section->pairs[i].value;
+        for (size_t i = 0; i < data->section_count; i++)
+        {
+            const INISection_t *section = section_at_(data, i);
+            const INISection_t *old_section = find_section_(update, section->name, section->name_length);
+            if (!old_section || !kept[section_position_(update, old_section)])
+                report_section_(handler, user, old_section, section);
+        }
+        for (size_t i = 0; i < update->section_count; i++)
+        {
+            const INISection_t *old_section = section_at_(update, i);
+            if (!find_section_(data, old_section->name, old_section->name_length))
+                report_section_(handler, user, old_section, NULL);
+        }
     }
 
-    return NULL;
+    free(kept);
+    ini_free(update);
+    return true;
 }
 
 
 
 void ini_free(INIData_t *data)
 {
-    if (!data) return;
+    if (!data || data->arena) return;
     free_data_sections_(data);
+    free_data_buffer_(data);
     free(data);
 }
 
 
 
-static const char *skip_ignored_characters_(const char *c)
+#define O CLASS_OTHER
+#define W CLASS_WHITESPACE
+#define S CLASS_SPACE
+#define C CLASS_COMMENT
+#define A CLASS_ALPHA
+#define D CLASS_DIGIT
+#define E CLASS_EQUALS
+#define Q CLASS_QUOTE
+#define L CLASS_OPEN
+#define R CLASS_CLOSE
+#define P CLASS_SPECIAL
+
+// Only ASCII is listed; the remaining bytes are CLASS_OTHER.
+static const unsigned char char_classes_[256] = {
+    O, O, O, O, O, O, O, O, O, W, W, W, W, W, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    S, O, Q, C, O, O, O, P, P, P, O, P, P, P, P, P,
+    D, D, D, D, D, D, D, D, D, D, P, C, O, E, O, O,
+    O, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, L, P, R, O, A,
+    O, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, P, O, P, O, O,
+};
+
+#undef O
+#undef W
+#undef S
+#undef C
+#undef A
+#undef D
+#undef E
+#undef Q
+#undef L
+#undef R
+#undef P
+
+
+
+/*
+ * Transitions of the line scanner by state and character class.
+ * Anything not listed is STATE_FAIL.
+ */
+static const unsigned char transitions_[STATE_COUNT][CLASS_COUNT] = {
+    [STATE_LINE] = {
+        [CLASS_WHITESPACE] = STATE_LINE, [CLASS_SPACE] = STATE_LINE, [CLASS_COMMENT] = STATE_END,
+        [CLASS_ALPHA] = STATE_KEY, [CLASS_OPEN] = STATE_SECTION_OPEN,
+    },
+    [STATE_PAIR] = {
+        [CLASS_WHITESPACE] = STATE_PAIR, [CLASS_SPACE] = STATE_PAIR, [CLASS_COMMENT] = STATE_END,
+        [CLASS_ALPHA] = STATE_KEY,
+    },
+    [STATE_SECTION] = {
+        [CLASS_WHITESPACE] = STATE_SECTION, [CLASS_SPACE] = STATE_SECTION, [CLASS_COMMENT] = STATE_END,
+        [CLASS_OPEN] = STATE_SECTION_OPEN,
+    },
+    [STATE_KEY] = {
+        [CLASS_ALPHA] = STATE_KEY, [CLASS_DIGIT] = STATE_KEY,
+        [CLASS_WHITESPACE] = STATE_KEY_END, [CLASS_SPACE] = STATE_KEY_END, [CLASS_COMMENT] = STATE_END,
+        [CLASS_EQUALS] = STATE_VALUE_START, [CLASS_OPEN] = STATE_BRACKET,
+    },
+    [STATE_KEY_END] = {
+        [CLASS_WHITESPACE] = STATE_KEY_END, [CLASS_SPACE] = STATE_KEY_END, [CLASS_COMMENT] = STATE_END,
+        [CLASS_EQUALS] = STATE_VALUE_START, [CLASS_OPEN] = STATE_BRACKET,
+    },
+    [STATE_VALUE_START] = {
+        [CLASS_WHITESPACE] = STATE_VALUE_START, [CLASS_SPACE] = STATE_VALUE_START, [CLASS_COMMENT] = STATE_END,
+        [CLASS_QUOTE] = STATE_QUOTED,
+        [CLASS_ALPHA] = STATE_VALUE, [CLASS_DIGIT] = STATE_VALUE, [CLASS_OPEN] = STATE_VALUE,
+        [CLASS_CLOSE] = STATE_VALUE, [CLASS_SPECIAL] = STATE_VALUE,
+    },
+    [STATE_VALUE] = {
+        [CLASS_ALPHA] = STATE_VALUE, [CLASS_DIGIT] = STATE_VALUE, [CLASS_OPEN] = STATE_VALUE,
+        [CLASS_CLOSE] = STATE_VALUE, [CLASS_SPECIAL] = STATE_VALUE,
+        [CLASS_WHITESPACE] = STATE_VALUE_END, [CLASS_SPACE] = STATE_VALUE_END, [CLASS_COMMENT] = STATE_END,
+    },
+    [STATE_QUOTED] = {
+        [CLASS_ALPHA] = STATE_QUOTED, [CLASS_DIGIT] = STATE_QUOTED, [CLASS_OPEN] = STATE_QUOTED,
+        [CLASS_CLOSE] = STATE_QUOTED, [CLASS_SPECIAL] = STATE_QUOTED, [CLASS_SPACE] = STATE_QUOTED,
+        [CLASS_QUOTE] = STATE_VALUE_END,
+    },
+    [STATE_VALUE_END] = {
+        [CLASS_WHITESPACE] = STATE_VALUE_END, [CLASS_SPACE] = STATE_VALUE_END, [CLASS_COMMENT] = STATE_END,
+        [CLASS_OPEN] = STATE_BRACKET,
+    },
+    [STATE_SECTION_OPEN] = {
+        [CLASS_WHITESPACE] = STATE_SECTION_OPEN, [CLASS_SPACE] = STATE_SECTION_OPEN, [CLASS_COMMENT] = STATE_END,
+        [CLASS_ALPHA] = STATE_NAME,
+    },
+    [STATE_NAME] = {
+        [CLASS_ALPHA] = STATE_NAME, [CLASS_DIGIT] = STATE_NAME,
+        [CLASS_WHITESPACE] = STATE_NAME_END, [CLASS_SPACE] = STATE_NAME_END, [CLASS_COMMENT] = STATE_END,
+        [CLASS_CLOSE] = STATE_SECTION_END,
+    },
+    [STATE_NAME_END] = {
+        [CLASS_WHITESPACE] = STATE_NAME_END, [CLASS_SPACE] = STATE_NAME_END, [CLASS_COMMENT] = STATE_END,
+        [CLASS_CLOSE] = STATE_SECTION_END,
+    },
+    [STATE_SECTION_END] = {
+        [CLASS_WHITESPACE] = STATE_SECTION_END, [CLASS_SPACE] = STATE_SECTION_END, [CLASS_COMMENT] = STATE_END,
+    },
+};
+
+
+
+static bool in_classes_(char c, unsigned classes)
 {
-    while (isspace(*c)) c++;
-    if (*c == ';' || *c == '#')
-        while (*c != '\0') c++;
-    return c;
+    return CLASS_BIT_(char_classes_[(unsigned char)c]) & classes;
 }
 
 
 
-// Assumes line is null-terminated.
-bool ini_is_blank_line(const char *line)
+static const char *skip_ignored_characters_(const char *c, const char *end)
 {
-    const char *c = skip_ignored_characters_(line);
-    return *c == '\0';
+    while (c < end && in_classes_(*c, IGNORED_CLASSES)) c++;
+    if (c < end && char_classes_[(unsigned char)*c] == CLASS_COMMENT)
+        c = end;
+    return c;
 }
 
 
 
-static bool is_valid_section_starting_character_(const char c)
+// Assumes line is null-terminated.
+bool ini_is_blank_line(const char *line)
 {
-    return (isalpha( (unsigned char) c)) || c == '_';
+    const char *end = line + strlen(line);
+    return skip_ignored_characters_(line, end) == end;
 }
 
 
+/*
+ * Vectorized scanning of key, section name and value runs. Each block
+ * of bytes is classified at once with range compares; the first byte
+ * outside of the set ends the run. The sets match the character
+ * classes above, which are used for the tail of a line and when no
+ * vector instructions are available.
+ */
+#if defined(__AVX2__)
 
-static bool is_valid_section_character_(const char c)
-{
-    return (isalnum((unsigned char)c)) || c == '_';
-}
+typedef __m256i simd_t;
+#define SIMD_WIDTH 32
+#define simd_load_(p) _mm256_loadu_si256((const __m256i *)(p))
+#define simd_set_(c) _mm256_set1_epi8(c)
+#define simd_eq_(a, b) _mm256_cmpeq_epi8(a, b)
+#define simd_set32_(x) _mm256_set1_epi32((int)(x))
+#define simd_eq32_(a, b) _mm256_cmpeq_epi32(a, b)
+#define simd_gt_(a, b) _mm256_cmpgt_epi8(a, b)
+#define simd_and_(a, b) _mm256_and_si256(a, b)
+#define simd_andnot_(a, b) _mm256_andnot_si256(a, b)
+#define simd_or_(a, b) _mm256_or_si256(a, b)
+#define simd_mask_(v) ((uint32_t)_mm256_movemask_epi8(v))
 
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
 
+typedef __m128i simd_t;
+#define SIMD_WIDTH 16
+#define simd_load_(p) _mm_loadu_si128((const __m128i *)(p))
+#define simd_set_(c) _mm_set1_epi8(c)
+#define simd_eq_(a, b) _mm_cmpeq_epi8(a, b)
+#define simd_set32_(x) _mm_set1_epi32((int)(x))
+#define simd_eq32_(a, b) _mm_cmpeq_epi32(a, b)
+#define simd_gt_(a, b) _mm_cmpgt_epi8(a, b)
+#define simd_and_(a, b) _mm_and_si128(a, b)
+#define simd_andnot_(a, b) _mm_andnot_si128(a, b)
+#define simd_or_(a, b) _mm_or_si128(a, b)
+#define simd_mask_(v) ((uint32_t)_mm_movemask_epi8(v))
 
-// Assumes line is null-terminated.
-bool ini_parse_section(const char *line, INISection_t *section, ptrdiff_t *error_offset)
-{
-    assert(line);
-    if (!line) return false;
+#endif
 
-    const char *c = line;
-    if (error_offset) *error_offset = 0;
 
-    char *dest_c = NULL;
-    if (section)
-    {
-        memset(section->name, 0, sizeof(section->name));
-        dest_c = section->name;
-    }
 
-    c = skip_ignored_characters_(c);
-    if (*c != '[') goto is_not_section;
-    c++;
-    c = skip_ignored_characters_(c);
+#ifdef SIMD_WIDTH
 
-    if (!is_valid_section_starting_character_(*c)) goto is_not_section;
-    while (is_valid_section_character_(*c))
-    {
-        if (dest_c)
-        {
-            if (dest_c - section->name >= INI_MAX_STRING_SIZE)
-                return false;
-            *dest_c++ = *c;
-        }
-        c++;
-    }
-    if (dest_c) *dest_c = '\0';
+#define SIMD_FULL_MASK ((uint32_t)(((uint64_t)1 << SIMD_WIDTH) - 1))
 
-    c = skip_ignored_characters_(c);
-    if (*c != ']') goto is_not_section;
-    c++;
 
-    c = skip_ignored_characters_(c);
-    if (*c != '\0') goto is_not_section;
 
-    return true;
+static unsigned first_set_bit_(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
 
-    is_not_section:
-    if (error_offset) *error_offset = c - line;
-    if (section)
-        section->name[0] = '\0';
-    return false;
+
+
+// Signed compares are fine here: bytes of 0x80 and above are negative and never in range.
+static simd_t simd_in_range_(simd_t v, char low, char high)
+{
+    return simd_and_(simd_gt_(v, simd_set_((char)(low - 1))), simd_gt_(simd_set_((char)(high + 1)), v));
 }
 
 
 
-static bool is_valid_key_starting_value_(const char c)
+// [0-9A-Za-z_]
+static simd_t simd_name_characters_(simd_t v)
 {
-    return (isalpha( (unsigned char) c)) || c == '_';
+    simd_t valid = simd_in_range_(v, '0', '9');
+    valid = simd_or_(valid, simd_in_range_(v, 'A', 'Z'));
+    valid = simd_or_(valid, simd_in_range_(v, 'a', 'z'));
+    return simd_or_(valid, simd_eq_(v, simd_set_('_')));
 }
 
 
 
-static bool is_valid_key_character_(const char c)
+/*
+ * Alphanumerics and _-+.,:'()[]{}\/ which, in ASCII order, are the
+ * ranges '\''..':' without '*', 'A'..']' and 'a'..'{', plus '_' and '}'.
+ */
+static simd_t simd_value_characters_(simd_t v, bool quoted)
 {
-    return (isalnum((unsigned char)c)) || c == '_';
+    simd_t valid = simd_andnot_(simd_eq_(v, simd_set_('*')), simd_in_range_(v, '\'', ':'));
+    valid = simd_or_(valid, simd_in_range_(v, 'A', ']'));
+    valid = simd_or_(valid, simd_in_range_(v, 'a', '{'));
+    valid = simd_or_(valid, simd_eq_(v, simd_set_('_')));
+    valid = simd_or_(valid, simd_eq_(v, simd_set_('}')));
+    if (quoted) valid = simd_or_(valid, simd_eq_(v, simd_set_(' ')));
+    return valid;
 }
 
+#endif
 
 
-static bool is_valid_value_character_(const char c, const bool quoted)
+
+// Returns the first character in [c, end) that is not a valid key or section name character.
+static const char *span_name_characters_(const char *c, const char *end)
 {
-    if (isalnum((unsigned char)c)) return true;
-    const char valid_special[] = "_-+.,:\'()[]{}\\/";
-    for (const char *p = valid_special; *p != '\0'; p++)
-        if (c == *p) return true;
-    if (quoted && c == ' ') return true;
-    return false;
+#ifdef SIMD_WIDTH
+    while (end - c >= SIMD_WIDTH)
+    {
+        const uint32_t invalid = ~simd_mask_(simd_name_characters_(simd_load_(c))) & SIMD_FULL_MASK;
+        if (invalid) return c + first_set_bit_(invalid);
+        c += SIMD_WIDTH;
+    }
+#endif
+    while (c < end && in_classes_(*c, NAME_CLASSES)) c++;
+    return c;
 }
 
 
 
-// Assumes line is null-terminated.
-bool ini_parse_pair(const char *line, INIPair_t *pair, ptrdiff_t *error_offset)
+// Returns the first character in [c, end) that is not a valid value character.
+static const char *span_value_characters_(const char *c, const char *end, bool quoted)
 {
-    assert(line);
-    if (!line) return false;
+#ifdef SIMD_WIDTH
+    while (end - c >= SIMD_WIDTH)
+    {
+        const uint32_t invalid = ~simd_mask_(simd_value_characters_(simd_load_(c), quoted)) & SIMD_FULL_MASK;
+        if (invalid) return c + first_set_bit_(invalid);
+        c += SIMD_WIDTH;
+    }
+#endif
+    const unsigned classes = quoted ? QUOTED_VALUE_CLASSES : VALUE_CLASSES;
+    while (c < end && in_classes_(*c, classes)) c++;
+    return c;
+}
 
-    if (error_offset) *error_offset = 0;
-    const char *c = line;
-    char *dest_c = NULL;
 
-    if (pair)
+
+
+// Returns the index of the first of hashes[start, count) equal to `hash`, or `count` if there is none.
+static unsigned find_hash_(const uint32_t *hashes, unsigned start, unsigned count, uint32_t hash)
+{
+    unsigned i = start;
+#ifdef SIMD_WIDTH
+    const simd_t needle = simd_set32_(hash);
+    for (; count - i >= SIMD_WIDTH / 4; i += SIMD_WIDTH / 4)
     {
-        memset(pair->key, 0, sizeof(pair->key));
-        dest_c = pair->key;
+        // Each matching hash sets four bits of the byte mask.
+        const uint32_t match = simd_mask_(simd_eq32_(simd_load_(hashes + i), needle));
+        if (match) return i + first_set_bit_(match) / 4;
     }
-    c = skip_ignored_characters_(c);
+#endif
+    for (; i < count; i++)
+        if (hashes[i] == hash) return i;
+    return count;
+}
 
 
-    // Key
-    if (!is_valid_key_starting_value_(*c)) goto is_not_pair;
-    while (is_valid_key_character_(*c))
+
+/*
+ * Scans a line from `start` with one transition per character,
+ * except that runs of key, name and value characters are skipped
+ * at once. For pairs, `first` and `second` receive the key and
+ * value; for sections, `first` receives the name. On failure,
+ * `error_offset` receives the offset of the offending character,
+ * or the length of the line if it ended too early.
+ */
+static INIToken_t run_machine_(const char *line, size_t length, unsigned char start, INIView_t *first, INIView_t *second, ptrdiff_t *error_offset)
+{
+    const char *const end = line + length;
+    const char *c = line;
+    unsigned char state = start;
+    unsigned char next = state;
+    *error_offset = 0;
+    while (c < end)
     {
-        if (dest_c)
+        next = transitions_[state][char_classes_[(unsigned char)*c]];
+        if (next == state)
         {
-            if (dest_c - pair->key >= INI_MAX_STRING_SIZE) return false;
-            *dest_c++ = *c;
+            c++;
+            continue;
         }
-        c++;
-    }
-    if (dest_c) *dest_c = '\0';
+        if (next <= STATE_BRACKET) break;
 
-    c = skip_ignored_characters_(c);
-    if (*c != '=') goto is_not_pair;
-    c++;
-    c = skip_ignored_characters_(c);
+        if (state == STATE_KEY || state == STATE_NAME)
+            first->length = c - first->ptr;
+        else if (state == STATE_VALUE)
+            second->length = c - second->ptr;
+        else if (state == STATE_QUOTED)
+            second->length = c + 1 - second->ptr;
 
-    if (pair)
+        state = next;
+        switch (state)
+        {
+            case STATE_KEY:
+            case STATE_NAME:
+                first->ptr = c;
+                c = span_name_characters_(c, end);
+                break;
+
+            case STATE_VALUE_START:
+                // An empty value points at the character after '=', which is safe to overwrite.
+                second->ptr = ++c;
+                second->length = 0;
+                break;
+
+            case STATE_VALUE:
+                second->ptr = c;
+                c = span_value_characters_(c, end, false);
+                break;
+
+            case STATE_QUOTED:
+                second->ptr = c;
+                c = span_value_characters_(c + 1, end, true);
+                break;
+
+            default:
+                c++;
+        }
+    }
+
+    const bool in_section = state == STATE_SECTION || state >= STATE_SECTION_OPEN;
+    if (c < end && next == STATE_FAIL)
     {
-        memset(pair->value, 0, sizeof(pair->value));
-        dest_c = pair->value;
+        *error_offset = c - line;
+        return in_section ? TOKEN_BAD_SECTION : TOKEN_BAD_PAIR;
+    }
+    if (c < end && next == STATE_BRACKET)
+    {
+        // A whole line with a '[' after its key is taken for a section, which fails at the key.
+        *error_offset = (start == STATE_LINE ? first->ptr : c) - line;
+        return start == STATE_LINE ? TOKEN_BAD_SECTION : TOKEN_BAD_PAIR;
     }
 
+    // The line ended, possibly at a comment.
+    if (state == STATE_KEY || state == STATE_NAME)
+        first->length = c - first->ptr;
+    else if (state == STATE_VALUE)
+        second->length = c - second->ptr;
 
-    // value
-    bool quoted = false;
-    if (*c == '"')
+    switch (state)
     {
-        quoted = true;
-        if (dest_c) *dest_c++ = *c;
-        c++;
+        case STATE_LINE:
+            return TOKEN_BLANK;
+
+        case STATE_VALUE_START:
+        case STATE_VALUE:
+        case STATE_VALUE_END:
+            return TOKEN_PAIR;
+
+        case STATE_SECTION_END:
+            return TOKEN_SECTION;
+
+        default:
+            *error_offset = length;
+            return in_section ? TOKEN_BAD_SECTION : TOKEN_BAD_PAIR;
     }
-    while (is_valid_value_character_(*c, quoted))
+}
+
+
+
+// Assumes line is null-terminated.
+bool ini_parse_section(const char *line, INISection_t *section, ptrdiff_t *error_offset)
+{
+    assert(line);
+    if (!line) return false;
+
+    if (section)
     {
-        if (dest_c)
-        {
-            if (dest_c - pair->value >= INI_MAX_STRING_SIZE) return false;
-            *dest_c++ = *c;
-        }
-        c++;
+        section->name = "";
+        section->name_length = 0;
     }
-    if (quoted)
+
+    INIView_t name, unused;
+    ptrdiff_t offset;
+    const INIToken_t token = run_machine_(line, strlen(line), STATE_SECTION, &name, &unused, &offset);
+    if (error_offset) *error_offset = offset;
+    if (token != TOKEN_SECTION)
+        return false;
+
+    if (section)
     {
-        if (*c != '"') goto is_not_pair;
-        if (dest_c) *dest_c++ = *c;
-        c++;
+        section->name = name.ptr;
+        section->name_length = name.length;
     }
-    if (dest_c) *dest_c = '\0';
-    c = skip_ignored_characters_(c);
+    return true;
+}
 
-    if (*c != '\0')
-        goto is_not_pair;
 
-    return true;
 
-    is_not_pair:
-    if (error_offset) *error_offset = c - line;
+// Assumes line is null-terminated.
+bool ini_parse_pair(const char *line, INIPair_t *pair, ptrdiff_t *error_offset)
+{
+    assert(line);
+    if (!line) return false;
+
+    if (pair)
+    {
+        memset(pair->key, 0, sizeof(pair->key));
+        memset(pair->value, 0, sizeof(pair->value));
+    }
+
+    INIView_t key, value;
+    ptrdiff_t offset;
+    const INIToken_t token = run_machine_(line, strlen(line), STATE_PAIR, &key, &value, &offset);
+    if (error_offset) *error_offset = offset;
+    if (token != TOKEN_PAIR)
+        return false;
+    if (key.length >= INI_MAX_STRING_SIZE || value.length >= INI_MAX_STRING_SIZE)
+        return false;
+
     if (pair)
     {
-        pair->key[0] = '\0';
-        pair->value[0] = '\0';
+        memcpy(pair->key, key.ptr, key.length);
+        memcpy(pair->value, value.ptr, value.length);
     }
-    return false;
+    return true;
 }
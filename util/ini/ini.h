@@ -5,8 +5,11 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include "../arena/arena.h"
+
 
 
 #define INI_MAX_STRING_SIZE 256
@@ -15,7 +18,22 @@
 
 
 /*
- * Key=value pair
+ * A (pointer, length) view of a string that is not
+ * necessarily null-terminated.
+ */
+typedef struct
+{
+    const char *ptr;
+    size_t length;
+} INIView_t;
+
+
+
+/*
+ * Key=value pair, with room for keys and values of up to
+ * INI_MAX_STRING_SIZE - 1 characters. Used by
+ * ini_parse_pair() and ini_add_pair(); pairs inside of a
+ * section are stored as INIEntry_t and have no such limit.
  */
 typedef struct
 {
@@ -25,25 +43,102 @@ typedef struct
 
 
 
+/*
+ * A key=value pair as it is stored inside of a section.
+ *
+ * Key and value are null-terminated, but they are not
+ * owned by the entry. They either point into the section's
+ * string storage, or directly into the file contents of a
+ * document created with ini_parse_mapped().
+ *
+ * `cache` holds the last typed conversion of the value made
+ * by ini_get_int() and friends. Change values with
+ * ini_set_value() so that it is reset.
+ */
+typedef struct
+{
+    const char *key;
+    const char *value;
+    size_t key_length;
+    size_t value_length;
+    struct {
+        unsigned char type;
+        bool valid;
+        union {
+            long long integer;
+            double real;
+            bool boolean;
+            size_t size;
+        } as;
+    } cache;
+} INIEntry_t;
+
+
+
+/*
+ * Sections and pairs are stored in blocks that double in
+ * size, so that existing ones never move and growing never
+ * copies them. Pointers to sections and pairs stay valid
+ * until the document is freed, except across ini_apply(),
+ * which replaces the sections of a document. Use
+ * ini_section_at() and ini_pair_at() to reach them by
+ * position.
+ */
+#define INI_MAX_BLOCKS 32
+
+
+
 /*
  * [Section]
  *
- * Keeps track of encapsulated pairs, the number of pairs,
- * and the number of allocated pairs.
+ * Keeps track of encapsulated pairs and the number of
+ * pairs. Strings copied into the section are kept in
+ * `strings`. Each block of pairs is followed by the
+ * hashes of their keys, so that a key lookup scans a
+ * dense array and only touches a pair whose hash matches.
+ * Once a section holds enough pairs, keys are also
+ * tracked by a hash index.
+ * `name` is null-terminated and `name_length` long; like
+ * keys, it has no length limit and is kept in `strings`,
+ * or in the `intern` table if there is one.
+ * Sections belonging to an arena-backed document allocate
+ * from `arena`, which is NULL otherwise. In a document
+ * created with ini_parse_lazy(), `pending` holds the lines
+ * of a section whose pairs have not been parsed yet, and
+ * is NULL otherwise. `order` lists the keys in sorted
+ * order once one of the ini_iter_*() functions needed it,
+ * and is rebuilt when pairs have been added since. Keys
+ * of a section with an `intern` table are interned there
+ * as well, see ini_parse_file_interned().
  */
 typedef struct
 {
-    char name[INI_MAX_STRING_SIZE];
-    INIPair_t *pairs;
-    unsigned pair_count;
-    unsigned pair_allocation;
+    const char *name;
+    size_t name_length;
+    INIEntry_t *pair_blocks[INI_MAX_BLOCKS];
+    size_t pair_count;
+    struct INIStringBlock *strings;
+    struct INIIndexSlot *index;
+    unsigned index_capacity;
+    arena_t *arena;
+    char *pending;
+    size_t pending_length;
+    struct INIKeyOrder *order;
+    size_t order_count;
+    struct INIInternTable *intern;
 } INISection_t;
 
 
 
 /*
  * Data structure for INI contents. Keeps track of
- * sections and the number of sections.
+ * sections and the number of sections. Section names
+ * are tracked by a hash index once there are enough
+ * sections. `generation` changes whenever sections or
+ * pairs are added through the document, which
+ * invalidates INIHandle_t objects resolved before.
+ * `intern` is the table given to ini_parse_file_interned(),
+ * and NULL otherwise.
  */
 typedef struct
 {
@@ -53,13 +148,35 @@ typedef struct
         char line[INI_MAX_LINE_SIZE];
         ptrdiff_t offset;
     } error;
-    INISection_t *sections;
-    unsigned section_count;
-    unsigned section_allocation;
+    struct {
+        char *begin;
+        size_t size;
+        bool mapped;
+    } buffer;
+    arena_t *arena;
+    INISection_t *section_blocks[INI_MAX_BLOCKS];
+    size_t section_count;
+    struct INIIndexSlot *section_index;
+    unsigned section_index_capacity;
+    unsigned generation;
+    struct INIInternTable *intern;
 } INIData_t;
 
 
 
+/*
+ * A resolved section and key, see ini_resolve(). A handle
+ * with a `generation` of zero never resolves to anything.
+ */
+typedef struct
+{
+    size_t section;
+    size_t pair;
+    unsigned generation;
+} INIHandle_t;
+
+
+
 /*
  * Parse an ini file and populate a data structure
  * with contents. User will need to free the returned
@@ -71,23 +188,562 @@ typedef struct
  *
  *
  * Returns:
- *   A pointer to an INIData_t object. Object contains
- *   heap-allocated data.
+ *   A pointer to an INIData_t object. Object contains
+ *   heap-allocated data.
+ */
+INIData_t *ini_parse_file(FILE *file);
+
+
+
+/*
+ * Same as ini_parse_file(), but the document, its sections,
+ * pairs and strings are all allocated from `arena`. Such a
+ * document is released all at once with arena_clear(), and
+ * ini_free() does nothing for it.
+ *
+ * If the arena runs out, the document is moved to the heap
+ * and parsing continues there; the arena gets back all of the
+ * space the parse took. In that case `arena` of the returned
+ * object is NULL and it must be freed with ini_free().
+ *
+ * Params:
+ *   file  - File to parse
+ *   arena - Arena to allocate the document from.
+ *
+ * Returns:
+ *   A pointer to an INIData_t object.
+ */
+INIData_t *ini_parse_file_arena(FILE *file, arena_t *arena);
+
+
+
+/*
+ * Chooses the sections kept by ini_parse_file_filtered().
+ * `accept` is called with the name of every section and
+ * returns whether to keep it; `user` is passed through.
+ */
+typedef struct
+{
+    bool (*accept)(void *user, INIView_t name);
+    void *user;
+} INISectionFilter_t;
+
+
+
+/*
+ * Same as ini_parse_file(), but only keeps the sections
+ * chosen by `filter`. The lines of other sections are
+ * skipped up to the next line starting with '[', without
+ * being parsed or stored, so errors inside of them are not
+ * reported. Neither are duplicates of a skipped section.
+ *
+ * Params:
+ *   file   - File to parse
+ *   filter - Chooses the sections to keep.
+ *
+ * Returns:
+ *   A pointer to an INIData_t object. Errors are reported
+ *   the same way as in ini_parse_file().
+ */
+INIData_t *ini_parse_file_filtered(FILE *file, const INISectionFilter_t *filter);
+
+
+
+/*
+ * Same as ini_parse_file_filtered(), keeping only the
+ * sections named in `names`.
+ *
+ * Params:
+ *   file  - File to parse
+ *   names - Names of the sections to keep.
+ *   count - Number of names in `names`.
+ */
+INIData_t *ini_parse_file_sections(FILE *file, const char *const *names, size_t count);
+
+
+
+/*
+ * A table of strings shared by many documents, so that a
+ * string they have in common is only stored once. Strings
+ * are allocated from arenas owned by the table, and stay
+ * until the table is freed.
+ */
+typedef struct INIInternTable INIInternTable_t;
+
+
+
+/*
+ * Create an intern table.
+ *
+ * Params:
+ *   values - Whether values are interned as well as keys.
+ *
+ * Returns:
+ *   A pointer to the table, or NULL if it could not be
+ *   allocated.
+ */
+INIInternTable_t *ini_intern_create(bool values);
+
+
+
+/*
+ * Number of bytes held by the strings of an intern table.
+ */
+size_t ini_intern_size(const INIInternTable_t *table);
+
+
+
+/*
+ * Free an intern table. Documents using the table must be
+ * freed first.
+ */
+void ini_intern_free(INIInternTable_t *table);
+
+
+
+/*
+ * Same as ini_parse_file(), but section names, keys, and
+ * values if the table was created to, are interned in
+ * `table` instead of being copied into each section. Keys
+ * of the document, including ones added later, are
+ * compared by address in ini_get_value() and other lookups.
+ *
+ * Only strings are shared. Each document still allocates
+ * its own INIData_t, which holds over 2 KiB of error
+ * buffers, as well as its sections and pairs, and those
+ * usually take more room than the strings do. Interning
+ * trims a document by a fraction, not by an order of
+ * magnitude.
+ *
+ * A table must not be used by several threads at once,
+ * including through lookups in documents using it.
+ *
+ * Params:
+ *   file  - File to parse
+ *   table - Table to intern strings in.
+ *
+ * Returns:
+ *   A pointer to an INIData_t object. Errors are reported
+ *   the same way as in ini_parse_file().
+ */
+INIData_t *ini_parse_file_interned(FILE *file, INIInternTable_t *table);
+
+
+
+/*
+ * Parse an ini file by memory-mapping it instead of reading
+ * it line by line. Keys and values are not copied; entries
+ * point directly into the mapping, which is kept alive until
+ * ini_free() is called. The mapping is private, so the file
+ * on disk is never modified.
+ *
+ * Keys and values are null-terminated by writing into the
+ * mapping, so each page holding a pair is copied on write and
+ * stops being shared with the page cache. The document then
+ * takes about the size of the file in private memory; what is
+ * saved compared to ini_parse_file() is the copy of every
+ * string and the string storage of each section.
+ *
+ * Params:
+ *   path - Path of the file to parse.
+ *
+ * Returns:
+ *   A pointer to an INIData_t object, or NULL if the file
+ *   could not be opened or mapped. Errors are reported the
+ *   same way as in ini_parse_file().
+ */
+INIData_t *ini_parse_mapped(const char *path);
+
+
+
+/*
+ * Parse ini contents that are already in memory. The buffer
+ * does not need to be null-terminated. Keys and values are
+ * copied, so the buffer may be released once this returns.
+ *
+ * Params:
+ *   buffer - Contents to parse
+ *   length - Number of bytes in `buffer`
+ *
+ * Returns:
+ *   A pointer to an INIData_t object. Errors are reported
+ *   the same way as in ini_parse_file().
+ */
+INIData_t *ini_parse_buffer(const char *buffer, size_t length);
+
+
+
+/*
+ * Parse an ini file lazily. Like ini_parse_mapped(), the
+ * file is mapped and kept until ini_free() is called, but
+ * only section headers are parsed up front. The pairs of a
+ * section are parsed the first time it is looked up, e.g.
+ * by ini_has_section() or ini_get_value(). Only the pages of
+ * sections that have been parsed are copied on write, see
+ * ini_parse_mapped().
+ *
+ * Errors in section headers, and lines before the first
+ * section, are reported right away. An error inside of a
+ * section is recorded in `error` when the section is
+ * parsed, and leaves it without pairs; the first error
+ * found is kept. Use ini_load_sections() to check the
+ * whole file.
+ *
+ * Looking up a section may modify the document, so a
+ * lazily parsed document must not be read from several
+ * threads until ini_load_sections() has been called.
+ * Functions that go over the whole document, like
+ * ini_write_file() and ini_freeze(), parse every section.
+ *
+ * Params:
+ *   path - Path of the file to parse.
+ *
+ * Returns:
+ *   A pointer to an INIData_t object, or NULL if the file
+ *   could not be opened or mapped.
+ */
+INIData_t *ini_parse_lazy(const char *path);
+
+
+
+/*
+ * Parse every section of a document created with
+ * ini_parse_lazy() that has not been parsed yet. Does
+ * nothing for other documents.
+ *
+ * Params:
+ *   data - Document to load
+ *
+ * Returns:
+ *   False if the document has an error, which is then
+ *   described by `error`, true otherwise.
+ */
+bool ini_load_sections(INIData_t *data);
+
+
+
+/*
+ * Same as ini_parse_buffer(), but splits the contents at
+ * section headers and parses the parts on several threads.
+ * Parts are at least 64 KiB, so small contents are parsed
+ * on the calling thread alone. The result, including any
+ * error, is the same as that of ini_parse_buffer().
+ *
+ * Params:
+ *   buffer  - Contents to parse
+ *   length  - Number of bytes in `buffer`
+ *   threads - Most threads to use, or 0 for one per
+ *             online processor
+ *
+ * Returns:
+ *   A pointer to an INIData_t object.
+ */
+INIData_t *ini_parse_buffer_parallel(const char *buffer, size_t length, unsigned threads);
+
+
+
+/*
+ * Same as ini_parse_mapped(), but parses the mapping on
+ * several threads. See ini_parse_buffer_parallel().
+ */
+INIData_t *ini_parse_mapped_parallel(const char *path, unsigned threads);
+
+
+
+/*
+ * Parse many files, overlapping their reads. On Linux, files
+ * are opened, read and closed through io_uring in batches,
+ * and each is parsed as soon as it has been read. Where
+ * io_uring is not available, a pool of threads reads the
+ * files with blocking reads instead.
+ *
+ * Params:
+ *   paths   - Paths of the files to parse.
+ *   count   - Number of paths in `paths`.
+ *   results - Receives, for each path, a pointer to an
+ *             INIData_t object, or NULL if the file could not
+ *             be read. Errors are reported the same way as
+ *             in ini_parse_buffer().
+ *
+ * Returns:
+ *   The number of files that were read and parsed without
+ *   error.
+ */
+size_t ini_parse_many(const char *const *paths, size_t count, INIData_t **results);
+
+
+
+/*
+ * Callbacks for ini_parse_events(). Views passed to the
+ * callbacks are only valid for the duration of the call.
+ * Any callback may be NULL.
+ *
+ * on_section - Called for every [section] line.
+ * on_pair    - Called for every key=value line, along with
+ *              the name of the enclosing section.
+ * on_error   - Called with the offending line, the offset
+ *              of the erroneous character and a message
+ *              when a line cannot be parsed. Parsing stops
+ *              afterwards.
+ *
+ * Returning false from on_section or on_pair stops parsing.
+ */
+typedef struct
+{
+    bool (*on_section)(void *user, INIView_t name);
+    bool (*on_pair)(void *user, INIView_t section, INIView_t key, INIView_t value);
+    void (*on_error)(void *user, INIView_t line, ptrdiff_t offset, const char *msg);
+} INIHandler_t;
+
+
+
+/*
+ * Parse an ini file without building an INIData_t object,
+ * reporting its contents through callbacks instead. The only
+ * allocations are a line buffer that grows to fit the longest
+ * line and a copy of the current section name, both freed
+ * before returning. Since sections are
+ * not remembered, duplicate sections are not detected.
+ *
+ * Params:
+ *   file    - File to parse
+ *   handler - Callbacks to invoke
+ *   user    - Passed through to every callback
+ *
+ * Returns:
+ *   True if the whole file was parsed, false if parsing
+ *   failed or was stopped by a callback.
+ */
+bool ini_parse_events(FILE *file, const INIHandler_t *handler, void *user);
+
+
+
+/*
+ * Same as ini_parse_events(), but for ini contents that are
+ * already in memory. See ini_parse_buffer().
+ */
+bool ini_parse_events_buffer(const char *buffer, size_t length, const INIHandler_t *handler, void *user);
+
+
+
+/*
+ * A read-only, position-independent image of an INIData_t
+ * object. Sections and pairs are found through minimal perfect
+ * hashes, so a lookup is one hash and one comparison. See
+ * ini_freeze() and ini_load_snapshot().
+ */
+typedef struct INISnapshot INISnapshot_t;
+
+
+
+/*
+ * Freeze an INIData_t object into a compact, immutable
+ * INISnapshot_t for lookups in hot paths. Unlike the parsed
+ * document, the frozen copy has no spare capacity and keeps
+ * all strings in one contiguous block. `data` is not modified
+ * and may be freed afterwards.
+ *
+ * Params:
+ *   data - The INIData_t object to freeze.
+ *
+ * Returns:
+ *   A pointer to an INISnapshot_t object that must be freed
+ *   with ini_snapshot_free(), or NULL on allocation failure.
+ */
+INISnapshot_t *ini_freeze(const INIData_t *data);
+
+
+
+/*
+ * Write a binary snapshot of an INIData_t object. The snapshot
+ * records the size and modification time of the text file it
+ * was parsed from, so that ini_load_snapshot() can tell when
+ * it has gone stale.
+ *
+ * Params:
+ *   data        - The INIData_t object to write.
+ *   path        - Destination path of the snapshot.
+ *   source_path - Path of the ini file `data` was parsed
+ *                 from, or NULL if there is none.
+ *
+ * Returns:
+ *   True if the snapshot was written.
+ */
+bool ini_write_snapshot(const INIData_t *data, const char *path, const char *source_path);
+
+
+
+/*
+ * Load a snapshot written by ini_write_snapshot(). The file
+ * is mapped and used as-is: nothing is parsed and nothing is
+ * allocated per section or pair.
+ *
+ * If the snapshot is missing, damaged, was written by an
+ * incompatible version, or is older than `source_path`, the
+ * text file is parsed instead and the snapshot is rewritten
+ * from it.
+ *
+ * Params:
+ *   path        - Path of the snapshot.
+ *   source_path - Path of the ini file the snapshot was
+ *                 taken from, or NULL if there is none.
+ *
+ * Returns:
+ *   A pointer to an INISnapshot_t object that must be freed
+ *   with ini_snapshot_free(), or NULL if neither the snapshot
+ *   nor the text file could be loaded.
+ */
+INISnapshot_t *ini_load_snapshot(const char *path, const char *source_path);
+
+
+
+/*
+ * Snapshot counterparts of ini_has_section() and
+ * ini_get_value().
+ */
+bool ini_snapshot_has_section(const INISnapshot_t *snapshot, const char *section);
+const char *ini_snapshot_get_value(const INISnapshot_t *snapshot, const char *section, const char *key);
+
+
+
+/*
+ * Release a snapshot returned by ini_freeze() or
+ * ini_load_snapshot().
+ */
+void ini_snapshot_free(INISnapshot_t *snapshot);
+
+
+
+/*
+ * Use the contents of an INIData_t object to generate an
+ * INI file (or overwrite an existing one). The output is
+ * streamed through an INIWriter_t, so it is written in
+ * blocks rather than formatted in memory all at once.
+ *
+ * Params:
+ *   data - A pointer to the INIData_t object whose data
+ *          you would like to write
+ *   file - Destination file pointer.
+ *
+ * Returns:
+ *   True if everything was written, false if memory ran
+ *   out or writing failed.
+ */
+bool ini_write_file(const INIData_t *data, FILE *file);
+
+
+
+/*
+ * Same as ini_write_file(), but writes to a file descriptor
+ * with write(), bypassing stdio. Only available on POSIX
+ * systems.
+ *
+ * Returns:
+ *   True if everything was written.
+ */
+bool ini_write_fd(const INIData_t *data, int fd);
+
+
+
+/*
+ * The exact number of bytes ini_write_file() would write
+ * for `data`.
+ */
+size_t ini_write_size(const INIData_t *data);
+
+
+
+/*
+ * Format the contents of an INIData_t object into memory, as
+ * ini_write_file() would write them. No null terminator is
+ * added.
+ *
+ * Params:
+ *   data   - The INIData_t object to write.
+ *   buffer - Destination buffer.
+ *   size   - Size of `buffer`. If it is smaller than the
+ *            output, nothing is written.
+ *
+ * Returns:
+ *   The size of the output, as ini_write_size().
+ */
+size_t ini_write_buffer(const INIData_t *data, char *buffer, size_t size);
+
+
+
+/*
+ * Same as ini_write_buffer(), but into a null-terminated
+ * buffer allocated to fit, which must be freed by the caller.
+ *
+ * Params:
+ *   data   - The INIData_t object to write.
+ *   length - If not NULL, receives the length of the output.
+ *
+ * Returns:
+ *   The output, or NULL on allocation failure.
+ */
+char *ini_write_string(const INIData_t *data, size_t *length);
+
+
+
+/*
+ * Writes ini output incrementally, for producers that do not
+ * have an INIData_t object. Output is collected in `buffer`;
+ * if `file` is set, it is written there whenever the buffer
+ * fills up and on ini_writer_flush(), otherwise it stays in
+ * `buffer` (`length` bytes, not null-terminated) until the
+ * writer is freed. Once an allocation or write fails, `failed`
+ * is set and everything else is ignored.
+ */
+typedef struct
+{
+    char *buffer;
+    size_t length;
+    size_t capacity;
+    FILE *file;
+    bool failed;
+} INIWriter_t;
+
+
+
+/*
+ * Prepare a writer.
+ *
+ * Params:
+ *   writer - The writer.
+ *   file   - Destination file, or NULL to write to memory.
+ */
+void ini_writer_init(INIWriter_t *writer, FILE *file);
+
+
+
+/*
+ * Append a [section] line or a key=value line. Names, keys
+ * and values are written as they are, without validation.
+ *
+ * Returns:
+ *   False if the writer has failed.
  */
-INIData_t *ini_parse_file(FILE *file);
+bool ini_writer_begin_section(INIWriter_t *writer, INIView_t name);
+bool ini_writer_pair(INIWriter_t *writer, INIView_t key, INIView_t value);
 
 
 
 /*
- * Use the contents of an INIData_t object to generate an
- * INI file (or overwrite an existing one)
+ * Write buffered output to the writer's file. Does nothing
+ * for writers without a file.
  *
- * Params:
- *   data - A pointer to the INIData_t object whose data
- *          you would like to write
- *   file - Destination file pointer.
+ * Returns:
+ *   False if the writer has failed.
+ */
+bool ini_writer_flush(INIWriter_t *writer);
+
+
+
+/*
+ * Release the writer's buffer without flushing it.
  */
-void ini_write_file(const INIData_t *data, FILE *file);
+void ini_writer_free(INIWriter_t *writer);
 
 
 
@@ -107,8 +763,28 @@ INISection_t *ini_has_section(const INIData_t *data, const char *section);
 
 
 /*
- * Initialize a section with a name, an allocation for pairs,
- * and starting its pair count at 0.
+ * Reach a section or pair by position, in the order they
+ * were added. Like ini_has_section(), ini_section_at() parses
+ * a section of a lazy document first.
+ *
+ * Params:
+ *   data    - The INIData_t object holding the section.
+ *   section - The section holding the pair.
+ *   index   - Position of the section or pair.
+ *
+ * Returns:
+ *   A pointer to the section or pair, or NULL if `index` is
+ *   not below `section_count` or `pair_count`.
+ */
+INISection_t *ini_section_at(const INIData_t *data, size_t index);
+INIEntry_t *ini_pair_at(const INISection_t *section, size_t index);
+
+
+
+/*
+ * Initialize a section with a name, starting its pair count
+ * at 0. The name is copied into the section's string storage;
+ * blocks for pairs are allocated as pairs are added.
  *
  * Params:
  *   name    - The name of the section.
@@ -150,7 +826,7 @@ INISection_t *ini_add_section(INIData_t *data, const char *name);
  *   section within `data`, or NULL on failure (i.e., providing
  *   a name for a section that does not exist in `data`)
  */
-INIPair_t *ini_add_pair(INIData_t *data, const char *section, INIPair_t pair);
+INIEntry_t *ini_add_pair(INIData_t *data, const char *section, INIPair_t pair);
 
 
 
@@ -166,7 +842,28 @@ INIPair_t *ini_add_pair(INIData_t *data, const char *section, INIPair_t pair);
  * Returns:
  *   A pointer to the newly-added pair within the section.
  */
-INIPair_t *ini_add_pair_to_section(INISection_t *section, INIPair_t pair);
+INIEntry_t *ini_add_pair_to_section(INISection_t *section, INIPair_t pair);
+
+
+
+/*
+ * Same as ini_add_pair() and ini_add_pair_to_section(), but
+ * the key and value are copied straight from views into the
+ * section's string storage, with no INIPair_t in between and
+ * no limit on their length.
+ *
+ * Params:
+ *   data    - The INIData_t object containing `section`.
+ *   section - The section to acquire the pair.
+ *   key     - The key to copy.
+ *   value   - The value to copy.
+ *
+ * Returns:
+ *   A pointer to the newly-added pair within the section, or
+ *   NULL on failure.
+ */
+INIEntry_t *ini_emplace_pair(INIData_t *data, const char *section, INIView_t key, INIView_t value);
+INIEntry_t *ini_emplace_pair_to_section(INISection_t *section, INIView_t key, INIView_t value);
 
 
 
@@ -187,10 +884,477 @@ const char *ini_get_value(const INIData_t *data, const char *section, const char
 
 
 
+/*
+ * A section and key to look up with ini_get_values().
+ */
+typedef struct
+{
+    const char *section;
+    const char *key;
+} INIQuery_t;
+
+
+
+/*
+ * Retrieve many values at once. Each distinct section string
+ * is looked up only once, in whatever order the queries are
+ * listed; queries should reuse the same pointer for a section
+ * (as string literals do) to share that lookup.
+ *
+ * Params:
+ *   data    - The INIData_t object to be searched.
+ *   queries - Sections and keys to search for.
+ *   n       - Number of queries.
+ *   out     - Receives the value for each query, or NULL
+ *             where the query is not found.
+ *
+ * Returns:
+ *   The number of queries that were found.
+ */
+size_t ini_get_values(const INIData_t *data, const INIQuery_t *queries, size_t n, const char **out);
+
+
+
+/*
+ * Typed counterparts of ini_get_value(). The value is
+ * converted on the first call and the result is cached in
+ * the pair, so later calls for the same type do no parsing.
+ *
+ * ini_get_int() accepts decimal and 0x-prefixed hexadecimal
+ * integers. ini_get_double() accepts decimal numbers with an
+ * optional fraction and exponent, e.g. "-1.5e3", with '.' as
+ * the decimal point. ini_get_bool() accepts true/false,
+ * yes/no, on/off and 1/0 in any case. ini_get_size() accepts
+ * a non-negative integer with an optional k, M, G or T suffix
+ * (powers of 1024), optionally followed by B, e.g. "64k" or
+ * "2MB". Conversions do not depend on the locale.
+ *
+ * Params:
+ *   data    - The INIData_t object to be searched.
+ *   section - The section to search for.
+ *   key     - The key to search for.
+ *   value   - Destination of the converted value. Left
+ *             untouched on failure.
+ *
+ * Returns:
+ *   True if the pair exists and its whole value converts to
+ *   the requested type, false otherwise.
+ */
+bool ini_get_int(INIData_t *data, const char *section, const char *key, long long *value);
+bool ini_get_double(INIData_t *data, const char *section, const char *key, double *value);
+bool ini_get_bool(INIData_t *data, const char *section, const char *key, bool *value);
+bool ini_get_size(INIData_t *data, const char *section, const char *key, size_t *value);
+
+
+
+/*
+ * Replace the value of an existing pair. The new value is
+ * copied into the section's storage and any cached typed
+ * conversion of the old value is discarded.
+ *
+ * Params:
+ *   data    - The INIData_t object to be modified.
+ *   section - The section of the pair.
+ *   key     - The key of the pair. Only the first pair with
+ *             this key is changed.
+ *   value   - The new value.
+ *
+ * Returns:
+ *   A pointer to the changed pair, or NULL if it does not
+ *   exist or the value could not be copied.
+ */
+INIEntry_t *ini_set_value(INIData_t *data, const char *section, const char *key, const char *value);
+
+
+
+/*
+ * Field types for ini_bind(), converted the same way as by
+ * the typed getters. Fields are of type const char *, long
+ * long, double, bool and size_t respectively. Strings point
+ * into the document.
+ */
+typedef enum
+{
+    INI_BIND_STRING,
+    INI_BIND_INT,
+    INI_BIND_DOUBLE,
+    INI_BIND_BOOL,
+    INI_BIND_SIZE,
+} INIBindType_t;
+
+
+
+/*
+ * Describes one field of a struct filled by ini_bind().
+ *
+ * section  - Section of the pair to bind.
+ * key      - Key of the pair to bind.
+ * type     - Type of the field.
+ * offset   - Offset of the field, from offsetof().
+ * fallback - Value used when the pair does not exist, or
+ *            NULL if the pair is required.
+ */
+typedef struct
+{
+    const char *section;
+    const char *key;
+    INIBindType_t type;
+    size_t offset;
+    const char *fallback;
+} INIBinding_t;
+
+
+
+typedef enum
+{
+    INI_BIND_OK,
+    INI_BIND_MISSING,
+    INI_BIND_INVALID,
+} INIBindStatus_t;
+
+
+
+/*
+ * Fill the fields of a struct from a document, as described
+ * by an array of bindings. Every field is processed, so that
+ * all missing and invalid fields can be reported at once.
+ * Failed fields are left untouched. Bindings for the same
+ * section that follow each other share one section lookup.
+ *
+ * Params:
+ *   data     - The INIData_t object to read from.
+ *   bindings - Fields to fill.
+ *   count    - Number of bindings.
+ *   object   - The struct to fill.
+ *   status   - Receives the outcome for each binding, or
+ *              NULL.
+ *
+ * Returns:
+ *   The number of fields that could not be filled.
+ */
+size_t ini_bind(INIData_t *data, const INIBinding_t *bindings, size_t count, void *object, INIBindStatus_t *status);
+
+
+
+/*
+ * Look up a section and key once, for repeated reads with
+ * ini_get_by_handle(). Values changed with ini_set_value()
+ * are seen through the handle. Adding sections or pairs to
+ * the document invalidates it.
+ *
+ * Params:
+ *   data    - The INIData_t object to be searched.
+ *   section - The section to search for.
+ *   key     - The key to search for.
+ *
+ * Returns:
+ *   A handle to the pair, or a handle with a `generation`
+ *   of zero if the pair does not exist.
+ */
+INIHandle_t ini_resolve(const INIData_t *data, const char *section, const char *key);
+
+
+
+/*
+ * Retrieve the value a handle from ini_resolve() refers to
+ * without searching for it.
+ *
+ * Params:
+ *   data   - The INIData_t object the handle was resolved in.
+ *   handle - The handle.
+ *
+ * Returns:
+ *   The value as a null-terminated C-string, or NULL if the
+ *   handle is invalid or out of date.
+ */
+const char *ini_get_by_handle(const INIData_t *data, INIHandle_t handle);
+
+
+
+/*
+ * Walks the pairs of a section in the byte order of their
+ * keys. See ini_iter_prefix() and ini_iter_range().
+ */
+typedef struct
+{
+    const INISection_t *section;
+    size_t next;
+    size_t end;
+} INIIterator_t;
+
+
+
+/*
+ * Iterate over the pairs of a section whose keys start with
+ * `prefix`, or that lie in [`low`, `high`). Either bound may
+ * be NULL to leave the range open on that side. Keys are
+ * ordered byte by byte, and pairs that share a key come in
+ * the order they were added.
+ *
+ * The first call sorts the keys of the section, later calls
+ * only search them, in O(log n). Adding pairs to the section
+ * ends any iteration in progress.
+ *
+ * Params:
+ *   section - The section to iterate over.
+ *   prefix  - Key prefix to match, "" for all keys.
+ *   low     - Smallest key to include.
+ *   high    - Key above the last one to include.
+ *   iter    - The iterator to set up.
+ *
+ * Returns:
+ *   False if the keys could not be sorted, true otherwise.
+ */
+bool ini_iter_prefix(INISection_t *section, const char *prefix, INIIterator_t *iter);
+bool ini_iter_range(INISection_t *section, const char *low, const char *high, INIIterator_t *iter);
+
+
+
+/*
+ * Advance an iterator set up by ini_iter_prefix() or
+ * ini_iter_range().
+ *
+ * Returns:
+ *   The next pair, or NULL once there are no more.
+ */
+const INIEntry_t *ini_iter_next(INIIterator_t *iter);
+
+
+
+/*
+ * Callbacks for ini_apply() and ini_watch(). Any callback may
+ * be NULL. A NULL old section or pair means it was added, a
+ * NULL new one means it was removed; otherwise it changed.
+ *
+ * on_section - Called for every section that was added,
+ *              removed or whose pairs changed.
+ * on_pair    - Called for every key that was added, removed
+ *              or given a different value, along with the
+ *              name of its section.
+ * on_error   - Only used by watchers. Called when the changed
+ *              file cannot be parsed, in which case the live
+ *              document is left as it was.
+ */
+typedef struct
+{
+    void (*on_section)(void *user, const INISection_t *old_section, const INISection_t *new_section);
+    void (*on_pair)(void *user, const char *section, const INIEntry_t *old_pair, const INIEntry_t *new_pair);
+    void (*on_error)(void *user, INIView_t line, ptrdiff_t offset, const char *msg);
+} INIDiffHandler_t;
+
+
+
+/*
+ * Replace the contents of `data` with those of `update`,
+ * reporting what changed. Sections that did not change keep
+ * their storage, so their pairs (and any cached conversions)
+ * stay where they were. The sections themselves are moved
+ * into new storage, so pointers to sections of `data` taken
+ * before the call, including those of a watcher's live
+ * document, must be looked up again. Callbacks run once
+ * `data` holds the new contents.
+ *
+ * Params:
+ *   data    - The live INIData_t object. Must not live in an
+ *             arena.
+ *   update  - A heap-allocated document, as returned by
+ *             ini_parse_file() or ini_parse_buffer(). It is
+ *             freed if the update is applied.
+ *   handler - Callbacks to invoke, or NULL.
+ *   user    - Passed through to every callback.
+ *
+ * Returns:
+ *   True if the update was applied, false if the arguments
+ *   are unsuitable or memory ran out, in which case neither
+ *   document is changed.
+ */
+bool ini_apply(INIData_t *data, INIData_t *update, const INIDiffHandler_t *handler, void *user);
+
+
+
+/*
+ * Watches an ini file and applies changes to a live document.
+ * See ini_watch().
+ */
+typedef struct INIWatcher INIWatcher_t;
+
+
+
+/*
+ * Parse an ini file and watch it for changes with inotify.
+ * Replacing the file (as most editors do) is noticed as well
+ * as writing to it. Changes are picked up by
+ * ini_watch_poll(). Only available on Linux.
+ *
+ * Params:
+ *   path    - Path of the ini file.
+ *   handler - Callbacks to invoke on changes, or NULL. The
+ *             structure is copied.
+ *   user    - Passed through to every callback.
+ *
+ * Returns:
+ *   A watcher that must be freed with ini_watch_free(), or
+ *   NULL if the file cannot be parsed or watched.
+ */
+INIWatcher_t *ini_watch(const char *path, const INIDiffHandler_t *handler, void *user);
+
+
+
+/*
+ * Wait up to `timeout_ms` milliseconds for the watched file
+ * to change, and if it did, reparse it and apply it to the
+ * live document with ini_apply().
+ *
+ * Params:
+ *   watcher    - The watcher.
+ *   timeout_ms - How long to wait. Zero only checks for
+ *                changes, a negative value waits forever.
+ *
+ * Returns:
+ *   True if the live document was updated.
+ */
+bool ini_watch_poll(INIWatcher_t *watcher, int timeout_ms);
+
+
+
+/*
+ * The live document of a watcher. It is owned by the watcher
+ * and stays at the same address across reloads, but its
+ * sections do not, see ini_apply().
+ */
+INIData_t *ini_watch_data(const INIWatcher_t *watcher);
+
+
+
+/*
+ * A file descriptor that becomes readable when the watched
+ * file may have changed, for use with poll() or epoll.
+ */
+int ini_watch_fd(const INIWatcher_t *watcher);
+
+
+
+/*
+ * Stop watching and free the live document.
+ */
+void ini_watch_free(INIWatcher_t *watcher);
+
+
+
+/*
+ * Publishes a current INIData_t object to any number of reader
+ * threads and swaps in replacements without blocking them.
+ * Replaced documents are freed once no reader can still be
+ * using them. See ini_publisher_create().
+ */
+typedef struct INIPublisher INIPublisher_t;
+
+
+
+/*
+ * A reader thread's registration with an INIPublisher_t. Each
+ * thread that reads needs its own. See ini_reader_register().
+ */
+typedef struct INIReader INIReader_t;
+
+
+
+/*
+ * Create a publisher for `data`, which it takes ownership of.
+ * Sections of a document from ini_parse_lazy() that have not
+ * been parsed yet are parsed first, as by ini_load_sections().
+ *
+ * Params:
+ *   data - The first document to publish. Must have been
+ *          returned by one of the ini_parse_* functions and
+ *          not live in an arena.
+ *
+ * Returns:
+ *   A publisher that must be freed with ini_publisher_free(),
+ *   or NULL on allocation failure.
+ */
+INIPublisher_t *ini_publisher_create(INIData_t *data);
+
+
+
+/*
+ * Replace the published document. Readers that are in the
+ * middle of a read keep the document they started with; the
+ * replaced document is freed once they have all finished.
+ * Publishing from several threads is safe but serialized.
+ *
+ * Params:
+ *   publisher - The publisher.
+ *   data      - The new document, which the publisher takes
+ *               ownership of. It must not be modified once
+ *               published. Pending sections of a lazy
+ *               document are parsed first.
+ *
+ * Returns:
+ *   True if `data` was published, false on allocation
+ *   failure, in which case the caller keeps ownership.
+ */
+bool ini_publish(INIPublisher_t *publisher, INIData_t *data);
+
+
+
+/*
+ * Free replaced documents that are no longer in use. This
+ * also happens on every ini_publish().
+ */
+void ini_publisher_reclaim(INIPublisher_t *publisher);
+
+
+
+/*
+ * Free a publisher along with the published document and all
+ * reader registrations. No thread may be reading.
+ */
+void ini_publisher_free(INIPublisher_t *publisher);
+
+
+
+/*
+ * Register the calling thread as a reader.
+ *
+ * Returns:
+ *   A registration for use with ini_read_begin() by a single
+ *   thread, or NULL on allocation failure.
+ */
+INIReader_t *ini_reader_register(INIPublisher_t *publisher);
+
+
+
+/*
+ * Give up a registration. It may be reused by a later
+ * ini_reader_register().
+ */
+void ini_reader_unregister(INIReader_t *reader);
+
+
+
+/*
+ * Pin and return the published document. It stays valid, and
+ * unchanged, until ini_read_end() is called. Neither function
+ * takes a lock. Reads may not be nested.
+ *
+ * Only read-only functions such as ini_get_value(),
+ * ini_has_section() and ini_get_by_handle() may be used on the
+ * pinned document; the typed accessors update caches in it.
+ * Published documents have no pending sections, so lookups in
+ * one from ini_parse_lazy() never parse, and are read-only too.
+ */
+const INIData_t *ini_read_begin(INIReader_t *reader);
+void ini_read_end(INIReader_t *reader);
+
+
+
 /*
  * Free the memory resources used by an INIData_t object.
  * This should be called if you have created an INIData_t
- * object with ini_parse_file()
+ * object with ini_parse_file(), ini_parse_buffer() or
+ * ini_parse_mapped(). Does
+ * nothing for documents that live in an arena.
  *
  * Params:
  *   data - The INIData_t object to be free'd.
@@ -245,11 +1409,14 @@ bool ini_parse_pair(const char *line, INIPair_t *pair, ptrdiff_t *error_offset);
  *
  * Params:
  *   line         - The character array to be parsed.
- *   section      - A pointer to a destination section to
- *                  store name strings. If NULL is provided,
- *                  has no effect. If a string is not a valid
- *                  section, then the name string is zero-length
- *                  and null-terminated.
+ *   section      - A pointer to a destination section whose
+ *                  `name` and `name_length` are set to the
+ *                  name as it appears within `line`, which
+ *                  is not null-terminated there. Nothing else
+ *                  of the section is touched. If NULL is
+ *                  provided, has no effect. If a string is
+ *                  not a valid section, then the name is
+ *                  empty.
  *   error_offset - A pointer to an integer representing the
  *                  offset of the erroneous character if
  *                  present. If no error found, will be given
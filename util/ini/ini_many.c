@@ -0,0 +1,451 @@
+#include "ini.h"
+
+
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define INI_USE_PREAD
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Opening, reading and closing files through io_uring came with
+ * IORING_FEAT_RW_CUR_POS, in Linux 5.6. With older kernel headers,
+ * or compilers that cannot check for them, files are read by the
+ * pool of threads alone.
+ */
+#if defined(__linux__) && defined(INI_USE_PREAD) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define INI_USE_IO_URING
+#include <sys/mman.h>
+#endif
+#endif
+#endif
+
+
+
+#define MANY_BUFFER_SIZE 16384
+#define MANY_QUEUE_DEPTH 64
+#define MANY_THREADS 16
+
+
+
+#ifdef INI_USE_PREAD
+
+// Doubles the capacity of a read buffer.
+static bool grow_buffer_(char **buffer, size_t *capacity)
+{
+    const size_t grown = *capacity ? *capacity * 2 : MANY_BUFFER_SIZE;
+    char *re = realloc(*buffer, grown);
+    if (!re) return false;
+    *buffer = re;
+    *capacity = grown;
+    return true;
+}
+
+
+
+// Reads a whole file into `*buffer`, which is kept for the next file, and parses it.
+static INIData_t *read_and_parse_(const char *path, char **buffer, size_t *capacity)
+{
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    size_t length = 0;
+    bool read_all = false;
+    while (length < *capacity || grow_buffer_(buffer, capacity))
+    {
+        const ssize_t count = pread(fd, *buffer + length, *capacity - length, (off_t)length);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0)
+        {
+            read_all = count == 0;
+            break;
+        }
+        length += (size_t)count;
+    }
+    close(fd);
+    return read_all ? ini_parse_buffer(*buffer, length) : NULL;
+}
+
+
+
+typedef struct
+{
+    const char *const *paths;
+    size_t count;
+    INIData_t **results;
+    atomic_size_t next;
+} INIManyJob_t;
+
+
+
+static void *load_files_(void *arg)
+{
+    INIManyJob_t *job = arg;
+    char *buffer = NULL;
+    size_t capacity = 0;
+    for (size_t i = atomic_fetch_add(&job->next, 1); i < job->count; i = atomic_fetch_add(&job->next, 1))
+        job->results[i] = read_and_parse_(job->paths[i], &buffer, &capacity);
+    free(buffer);
+    return NULL;
+}
+
+
+
+/*
+ * Loads files with blocking reads on a pool of threads, so that
+ * the latencies of several files overlap. The calling thread
+ * takes part, so files are loaded even if no thread starts.
+ */
+static void parse_pool_(const char *const *paths, size_t count, INIData_t **results)
+{
+    INIManyJob_t job = {paths, count, results, 0};
+    const size_t thread_count = count < MANY_THREADS ? count : MANY_THREADS;
+    pthread_t threads[MANY_THREADS];
+    size_t started = 0;
+    while (started + 1 < thread_count && pthread_create(&threads[started], NULL, load_files_, &job) == 0)
+        started++;
+    load_files_(&job);
+    for (size_t i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+}
+
+#else
+
+static void parse_pool_(const char *const *paths, size_t count, INIData_t **results)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        FILE *file = fopen(paths[i], "r");
+        results[i] = file ? ini_parse_file(file) : NULL;
+        if (file) fclose(file);
+    }
+}
+
+#endif
+
+
+
+#ifdef INI_USE_IO_URING
+
+/*
+ * The parts of an io_uring instance shared with the kernel.
+ * Entries are prepared at `*sq_tail + pending` and handed over
+ * by ring_submit_().
+ */
+typedef struct
+{
+    int fd;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    atomic_uint *sq_head;
+    atomic_uint *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    atomic_uint *cq_head;
+    atomic_uint *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned pending;
+} INIRing_t;
+
+
+
+static void ring_free_(INIRing_t *ring)
+{
+    if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != MAP_FAILED) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+
+
+static void *map_ring_(const INIRing_t *ring, size_t size, off_t offset)
+{
+    return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, offset);
+}
+
+
+
+// Returns false if io_uring, or opening and closing files through it, is not available.
+static bool ring_init_(INIRing_t *ring, unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) return false;
+
+    // Kernels older than the headers may still lack the feature.
+    ring->sq_ring = ring->cq_ring = ring->sqes = MAP_FAILED;
+    if (!(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        ring_free_(ring);
+        return false;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sq_ring = map_ring_(ring, ring->sq_ring_size, IORING_OFF_SQ_RING);
+    ring->cq_ring = map_ring_(ring, ring->cq_ring_size, IORING_OFF_CQ_RING);
+    ring->sqes = map_ring_(ring, ring->sqes_size, IORING_OFF_SQES);
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+        ring_free_(ring);
+        return false;
+    }
+
+    char *const sq = ring->sq_ring;
+    ring->sq_head = (atomic_uint *)(sq + params.sq_off.head);
+    ring->sq_tail = (atomic_uint *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    char *const cq = ring->cq_ring;
+    ring->cq_head = (atomic_uint *)(cq + params.cq_off.head);
+    ring->cq_tail = (atomic_uint *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    ring->pending = 0;
+    return true;
+}
+
+
+
+static struct io_uring_sqe *ring_prepare_(INIRing_t *ring, unsigned char opcode, int fd, uint64_t user_data)
+{
+    const unsigned tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    const unsigned index = (tail + ring->pending++) & *ring->sq_mask;
+    ring->sq_array[index] = index;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+    return sqe;
+}
+
+
+
+// Hands the prepared entries to the kernel and waits for at least one completion.
+static bool ring_submit_(INIRing_t *ring)
+{
+    const unsigned tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed) + ring->pending;
+    atomic_store_explicit(ring->sq_tail, tail, memory_order_release);
+    ring->pending = 0;
+
+    for (;;)
+    {
+        const unsigned unconsumed = tail - atomic_load_explicit(ring->sq_head, memory_order_acquire);
+        if (syscall(__NR_io_uring_enter, ring->fd, unconsumed, 1, IORING_ENTER_GETEVENTS, NULL, 0) >= 0) return true;
+        if (errno != EINTR) return false;
+    }
+}
+
+
+
+typedef enum
+{
+    STAGE_OPEN,
+    STAGE_READ,
+    STAGE_CLOSE,
+} INIManyStage_t;
+
+
+
+// A file being loaded through the ring. Each has at most one operation in flight.
+typedef struct
+{
+    size_t file;
+    int fd;
+    INIManyStage_t stage;
+    char *buffer;
+    size_t length;
+    size_t capacity;
+} INIManySlot_t;
+
+
+
+static void prepare_read_(INIRing_t *ring, INIManySlot_t *slot, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = ring_prepare_(ring, IORING_OP_READ, slot->fd, user_data);
+    sqe->addr = (uint64_t)(uintptr_t)(slot->buffer + slot->length);
+    sqe->len = (unsigned)(slot->capacity - slot->length);
+    sqe->off = slot->length;
+    slot->stage = STAGE_READ;
+}
+
+
+
+static void prepare_close_(INIRing_t *ring, INIManySlot_t *slot, uint64_t user_data)
+{
+    ring_prepare_(ring, IORING_OP_CLOSE, slot->fd, user_data);
+    slot->stage = STAGE_CLOSE;
+}
+
+
+
+/*
+ * Moves a file on to its next operation once the last one has
+ * completed with `res`. Returns false once the file is done with.
+ * A file is parsed as soon as it has been read, before it is closed.
+ */
+static bool advance_slot_(INIRing_t *ring, INIManySlot_t *slot, uint64_t user_data, int res, INIData_t **results)
+{
+    switch (slot->stage)
+    {
+        case STAGE_OPEN:
+            if (res < 0) return false;
+            slot->fd = res;
+            slot->length = 0;
+            if (slot->capacity == 0 && !grow_buffer_(&slot->buffer, &slot->capacity))
+                prepare_close_(ring, slot, user_data);
+            else
+                prepare_read_(ring, slot, user_data);
+            return true;
+
+        case STAGE_READ:
+            if (res == -EINTR || res == -EAGAIN)
+                prepare_read_(ring, slot, user_data);
+            else if (res > 0)
+            {
+                slot->length += (size_t)res;
+                if (slot->length < slot->capacity || grow_buffer_(&slot->buffer, &slot->capacity))
+                    prepare_read_(ring, slot, user_data);
+                else
+                    prepare_close_(ring, slot, user_data);
+            }
+            else
+            {
+                if (res == 0) results[slot->file] = ini_parse_buffer(slot->buffer, slot->length);
+                prepare_close_(ring, slot, user_data);
+            }
+            return true;
+
+        case STAGE_CLOSE:
+            return false;
+    }
+    assert(false);
+    return false;
+}
+
+
+
+/*
+ * Loads files through io_uring, keeping up to MANY_QUEUE_DEPTH of
+ * them in flight and submitting their operations in batches.
+ * Returns false if the ring failed, in which case `results` holds
+ * whatever was parsed so far.
+ */
+static bool parse_ring_(INIRing_t *ring, const char *const *paths, size_t count, INIData_t **results)
+{
+    INIManySlot_t slots[MANY_QUEUE_DEPTH];
+    unsigned free_slots[MANY_QUEUE_DEPTH];
+    unsigned free_count = MANY_QUEUE_DEPTH;
+    for (unsigned i = 0; i < MANY_QUEUE_DEPTH; i++)
+    {
+        slots[i].fd = -1;
+        slots[i].stage = STAGE_CLOSE;
+        slots[i].buffer = NULL;
+        slots[i].capacity = 0;
+        free_slots[i] = MANY_QUEUE_DEPTH - 1 - i;
+    }
+
+    size_t next = 0;
+    bool failed = false;
+    while (!failed && (next < count || free_count < MANY_QUEUE_DEPTH))
+    {
+        while (next < count && free_count)
+        {
+            const unsigned index = free_slots[--free_count];
+            INIManySlot_t *slot = &slots[index];
+            slot->file = next;
+            slot->fd = -1;
+            slot->stage = STAGE_OPEN;
+            struct io_uring_sqe *sqe = ring_prepare_(ring, IORING_OP_OPENAT, AT_FDCWD, index);
+            sqe->addr = (uint64_t)(uintptr_t)paths[next++];
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        }
+        if (!ring_submit_(ring))
+        {
+            failed = true;
+            break;
+        }
+
+        unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+        while (head != atomic_load_explicit(ring->cq_tail, memory_order_acquire))
+        {
+            const struct io_uring_cqe *cqe = &ring->cqes[head++ & *ring->cq_mask];
+            const unsigned index = (unsigned)cqe->user_data;
+            if (!advance_slot_(ring, &slots[index], index, cqe->res, results))
+                free_slots[free_count++] = index;
+        }
+        atomic_store_explicit(ring->cq_head, head, memory_order_release);
+    }
+
+    // After a failure, an operation still in flight may write to its
+    // buffer at any time, so those buffers are left allocated.
+    bool in_flight[MANY_QUEUE_DEPTH];
+    memset(in_flight, failed, sizeof(in_flight));
+    for (unsigned i = 0; i < free_count; i++)
+        in_flight[free_slots[i]] = false;
+    for (unsigned i = 0; i < MANY_QUEUE_DEPTH; i++)
+    {
+        if (!in_flight[i])
+            free(slots[i].buffer);
+        else if (slots[i].stage == STAGE_READ)
+            close(slots[i].fd);
+    }
+    return !failed;
+}
+
+#endif
+
+
+
+size_t ini_parse_many(const char *const *paths, size_t count, INIData_t **results)
+{
+    assert(paths || !count);
+    assert(results || !count);
+    if (!count || !paths || !results) return 0;
+
+    for (size_t i = 0; i < count; i++)
+        results[i] = NULL;
+
+    bool parsed = false;
+#ifdef INI_USE_IO_URING
+    INIRing_t ring;
+    if (ring_init_(&ring, MANY_QUEUE_DEPTH))
+    {
+        parsed = parse_ring_(&ring, paths, count, results);
+        ring_free_(&ring);
+        if (!parsed)
+            for (size_t i = 0; i < count; i++)
+            {
+                ini_free(results[i]);
+                results[i] = NULL;
+            }
+    }
+#endif
+    if (!parsed) parse_pool_(paths, count, results);
+
+    size_t successes = 0;
+    for (size_t i = 0; i < count; i++)
+        successes += results[i] && !results[i]->error.encountered;
+    return successes;
+}
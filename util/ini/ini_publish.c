@@ -0,0 +1,222 @@
+#include "ini.h"
+
+
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+
+
+#define CACHE_LINE_SIZE 64
+
+
+
+/*
+ * Readers announce the epoch they started reading in, or zero
+ * while they are not reading. Each reader has a cache line to
+ * itself so that readers on different cores never contend.
+ */
+struct INIReader
+{
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t epoch;
+    atomic_bool in_use;
+    struct INIReader *next;
+    INIPublisher_t *publisher;
+};
+
+
+
+typedef struct INIRetired
+{
+    INIData_t *data;
+    uint_fast64_t epoch;
+    struct INIRetired *next;
+} INIRetired_t;
+
+
+
+struct INIPublisher
+{
+    _Atomic(INIData_t *) current;
+    atomic_uint_fast64_t epoch;
+    _Atomic(INIReader_t *) readers;
+    atomic_flag lock;
+    INIRetired_t *retired;
+};
+
+
+
+static void lock_(INIPublisher_t *publisher)
+{
+    while (atomic_flag_test_and_set_explicit(&publisher->lock, memory_order_acquire))
+        ;
+}
+
+
+
+static void unlock_(INIPublisher_t *publisher)
+{
+    atomic_flag_clear_explicit(&publisher->lock, memory_order_release);
+}
+
+
+
+/*
+ * Frees retired documents that no reader can still be using: a
+ * document retired in epoch E is only visible to readers that
+ * started before E. Expects the lock to be held.
+ */
+static void reclaim_(INIPublisher_t *publisher)
+{
+    uint_fast64_t oldest = UINT_FAST64_MAX;
+    for (INIReader_t *reader = atomic_load(&publisher->readers); reader; reader = reader->next)
+    {
+        const uint_fast64_t epoch = atomic_load(&reader->epoch);
+        if (epoch && epoch < oldest) oldest = epoch;
+    }
+
+    INIRetired_t **link = &publisher->retired;
+    while (*link)
+    {
+        INIRetired_t *retired = *link;
+        if (retired->epoch > oldest)
+        {
+            link = &retired->next;
+            continue;
+        }
+        *link = retired->next;
+        ini_free(retired->data);
+        free(retired);
+    }
+}
+
+
+
+INIPublisher_t *ini_publisher_create(INIData_t *data)
+{
+    assert(data);
+    if (!data) return NULL;
+
+    INIPublisher_t *publisher = malloc(sizeof(INIPublisher_t));
+    if (!publisher) return NULL;
+    // Readers must never parse pending sections of a lazy document.
+    ini_load_sections(data);
+    atomic_init(&publisher->current, data);
+    atomic_init(&publisher->epoch, 1);
+    atomic_init(&publisher->readers, NULL);
+    atomic_flag_clear(&publisher->lock);
+    publisher->retired = NULL;
+    return publisher;
+}
+
+
+
+bool ini_publish(INIPublisher_t *publisher, INIData_t *data)
+{
+    assert(publisher);
+    assert(data);
+    if (!publisher || !data) return false;
+
+    INIRetired_t *retired = malloc(sizeof(INIRetired_t));
+    if (!retired) return false;
+    ini_load_sections(data);
+
+    lock_(publisher);
+    retired->data = atomic_exchange(&publisher->current, data);
+    // Readers that see the new epoch are guaranteed to see the new document.
+    retired->epoch = atomic_fetch_add(&publisher->epoch, 1) + 1;
+    retired->next = publisher->retired;
+    publisher->retired = retired;
+    reclaim_(publisher);
+    unlock_(publisher);
+    return true;
+}
+
+
+
+void ini_publisher_reclaim(INIPublisher_t *publisher)
+{
+    assert(publisher);
+    if (!publisher) return;
+    lock_(publisher);
+    reclaim_(publisher);
+    unlock_(publisher);
+}
+
+
+
+void ini_publisher_free(INIPublisher_t *publisher)
+{
+    if (!publisher) return;
+
+    ini_free(atomic_load(&publisher->current));
+    while (publisher->retired)
+    {
+        INIRetired_t *next = publisher->retired->next;
+        ini_free(publisher->retired->data);
+        free(publisher->retired);
+        publisher->retired = next;
+    }
+
+    INIReader_t *reader = atomic_load(&publisher->readers);
+    while (reader)
+    {
+        INIReader_t *next = reader->next;
+        free(reader);
+        reader = next;
+    }
+    free(publisher);
+}
+
+
+
+INIReader_t *ini_reader_register(INIPublisher_t *publisher)
+{
+    assert(publisher);
+    if (!publisher) return NULL;
+
+    // Reuse the slot of a reader that has unregistered if there is one.
+    for (INIReader_t *reader = atomic_load(&publisher->readers); reader; reader = reader->next)
+    {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&reader->in_use, &expected, true)) return reader;
+    }
+
+    INIReader_t *reader = aligned_alloc(CACHE_LINE_SIZE, sizeof(INIReader_t));
+    if (!reader) return NULL;
+    atomic_init(&reader->epoch, 0);
+    atomic_init(&reader->in_use, true);
+    reader->publisher = publisher;
+    reader->next = atomic_load(&publisher->readers);
+    while (!atomic_compare_exchange_weak(&publisher->readers, &reader->next, reader))
+        ;
+    return reader;
+}
+
+
+
+void ini_reader_unregister(INIReader_t *reader)
+{
+    if (!reader) return;
+    atomic_store(&reader->epoch, 0);
+    atomic_store(&reader->in_use, false);
+}
+
+
+
+const INIData_t *ini_read_begin(INIReader_t *reader)
+{
+    assert(reader);
+    INIPublisher_t *publisher = reader->publisher;
+    atomic_store(&reader->epoch, atomic_load(&publisher->epoch));
+    return atomic_load(&publisher->current);
+}
+
+
+
+void ini_read_end(INIReader_t *reader)
+{
+    assert(reader);
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+}
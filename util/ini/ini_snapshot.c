@@ -0,0 +1,800 @@
+#include "ini.h"
+
+
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define INI_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+
+#define SNAPSHOT_MAGIC "GINISNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+#define SNAPSHOT_ALIGNMENT 8
+#define SNAPSHOT_BUCKET_SIZE 4
+#define SNAPSHOT_SEED_ATTEMPTS 32
+
+
+
+/*
+ * On-disk layout. Everything after the header is addressed by
+ * offsets from the start of the image, so the image can be used
+ * from wherever it is mapped. Strings are null-terminated.
+ *
+ * Sections and pairs are looked up through minimal perfect hashes
+ * (hash and displace): a key's hash picks a bucket, the bucket's
+ * displacement picks the key's slot, and every slot holds exactly
+ * one item. A lookup is one hash and one comparison.
+ */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t image_size;
+    uint64_t checksum;
+    uint64_t source_size;
+    int64_t source_mtime;
+    int64_t source_mtime_nsec;
+    uint64_t hash_seed;
+    uint32_t section_count;
+    uint32_t pair_count;
+    uint32_t indexed_section_count;
+    uint32_t indexed_pair_count;
+    uint32_t section_bucket_count;
+    uint32_t pair_bucket_count;
+    uint64_t sections_offset;
+    uint64_t pairs_offset;
+    uint64_t section_displacements_offset;
+    uint64_t section_index_offset;
+    uint64_t pair_displacements_offset;
+    uint64_t pair_index_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+} SnapshotHeader_t;
+
+
+
+typedef struct
+{
+    uint32_t name;
+    uint32_t name_length;
+    uint32_t first_pair;
+    uint32_t pair_count;
+} SnapshotSection_t;
+
+
+
+typedef struct
+{
+    uint32_t section;
+    uint32_t key;
+    uint32_t key_length;
+    uint32_t value;
+} SnapshotPair_t;
+
+
+
+// `hash` is the low half of the item's hash, checked before its strings are compared.
+typedef struct
+{
+    uint32_t hash;
+    uint32_t position;
+} SnapshotSlot_t;
+
+
+
+typedef struct
+{
+    uint64_t size;
+    int64_t mtime;
+    int64_t mtime_nsec;
+} SourceStamp_t;
+
+
+
+struct INISnapshot
+{
+    char *image;
+    size_t size;
+    bool mapped;
+    const SnapshotHeader_t *header;
+    const SnapshotSection_t *sections;
+    const SnapshotPair_t *pairs;
+    const uint32_t *section_displacements;
+    const SnapshotSlot_t *section_index;
+    const uint32_t *pair_displacements;
+    const SnapshotSlot_t *pair_index;
+    const char *strings;
+};
+
+
+
+static uint64_t mix_(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9u;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBu;
+    return x ^ (x >> 31);
+}
+
+
+
+// 64-bit FNV-1a, continuing from `hash`.
+static uint64_t hash_bytes_(uint64_t hash, const char *str, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 0x100000001B3u;
+    }
+    return hash;
+}
+
+
+
+static uint64_t hash_section_(uint64_t seed, const char *section, size_t length)
+{
+    return hash_bytes_(0xCBF29CE484222325u ^ mix_(seed), section, length);
+}
+
+
+
+// Hash of "section\0key".
+static uint64_t hash_pair_(uint64_t seed, const char *section, size_t section_length, const char *key,
+                           size_t key_length)
+{
+    const uint64_t hash = hash_bytes_(hash_section_(seed, section, section_length), "", 1);
+    return hash_bytes_(hash, key, key_length);
+}
+
+
+
+static uint32_t bucket_of_(uint64_t hash, uint32_t bucket_count)
+{
+    return (uint32_t)((mix_(hash) >> 32) % bucket_count);
+}
+
+
+
+static uint32_t slot_of_(uint64_t hash, uint32_t displacement, uint32_t count)
+{
+    return (uint32_t)(mix_(hash + displacement * 0x9E3779B97F4A7C15u) % count);
+}
+
+
+
+// Word-at-a-time checksum; the image size is always a multiple of 8.
+static uint64_t checksum_(const char *bytes, size_t size)
+{
+    uint64_t sum = 0x9E3779B97F4A7C15u;
+    for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        sum = (sum ^ word) * 0x100000001B3u;
+        sum ^= sum >> 29;
+    }
+    return sum;
+}
+
+
+
+static size_t align_(size_t size)
+{
+    return (size + SNAPSHOT_ALIGNMENT - 1) & ~(size_t)(SNAPSHOT_ALIGNMENT - 1);
+}
+
+
+
+static uint32_t bucket_count_(uint32_t count)
+{
+    return count / SNAPSHOT_BUCKET_SIZE + 1;
+}
+
+
+
+static bool stamp_source_(const char *source_path, SourceStamp_t *stamp)
+{
+    memset(stamp, 0, sizeof(*stamp));
+    if (!source_path) return true;
+
+    struct stat st;
+    if (stat(source_path, &st) != 0) return false;
+    stamp->size = (uint64_t)st.st_size;
+    stamp->mtime = (int64_t)st.st_mtime;
+#if defined(__linux__)
+    stamp->mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    stamp->mtime_nsec = (int64_t)st.st_mtimespec.tv_nsec;
+#endif
+    return true;
+}
+
+
+
+static bool same_stamp_(const SourceStamp_t *a, const SourceStamp_t *b)
+{
+    return a->size == b->size && a->mtime == b->mtime && a->mtime_nsec == b->mtime_nsec;
+}
+
+
+
+static const char *image_string_(const char *strings, uint32_t offset)
+{
+    return strings + offset;
+}
+
+
+
+static bool pair_matches_(const SnapshotSection_t *sections, const SnapshotPair_t *pair, const char *strings,
+                          const char *section, size_t section_length, const char *key, size_t key_length)
+{
+    const SnapshotSection_t *pair_section = &sections[pair->section];
+    return pair->key_length == key_length
+           && pair_section->name_length == section_length
+           && memcmp(image_string_(strings, pair->key), key, key_length) == 0
+           && memcmp(image_string_(strings, pair_section->name), section, section_length) == 0;
+}
+
+
+
+/*
+ * Builds a minimal perfect hash over `count` distinct hashes.
+ * Buckets are placed largest first, each taking the first
+ * displacement that sends all of its keys to free slots. The
+ * slot of key i is filled with items[i]. Fails if some bucket
+ * cannot be placed, which a different seed will almost always fix.
+ */
+static bool build_perfect_hash_(const uint64_t *hashes, const uint32_t *items, uint32_t count, uint32_t bucket_count,
+                                uint32_t *displacements, SnapshotSlot_t *slots)
+{
+    if (!count) return true;
+
+    uint32_t *start = calloc((size_t)bucket_count + 1, sizeof(uint32_t));
+    uint32_t *fill = calloc(bucket_count, sizeof(uint32_t));
+    uint32_t *keys = malloc(sizeof(uint32_t) * count);
+    uint32_t *order = malloc(sizeof(uint32_t) * bucket_count);
+    bool *taken = calloc(count, sizeof(bool));
+    bool built = start && fill && keys && order && taken;
+
+    if (built)
+    {
+        // Group keys by bucket, then order the buckets largest first.
+        for (uint32_t i = 0; i < count; i++) start[bucket_of_(hashes[i], bucket_count) + 1]++;
+        uint32_t largest = 0;
+        for (uint32_t b = 0; b < bucket_count; b++)
+        {
+            if (start[b + 1] > largest) largest = start[b + 1];
+            start[b + 1] += start[b];
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t bucket = bucket_of_(hashes[i], bucket_count);
+            keys[start[bucket] + fill[bucket]++] = i;
+        }
+        uint32_t bucket_total = 0;
+        for (uint32_t size = largest; size > 0; size--)
+            for (uint32_t b = 0; b < bucket_count; b++)
+                if (start[b + 1] - start[b] == size) order[bucket_total++] = b;
+
+        const uint64_t attempts = (uint64_t)count * 16 + 1024 < UINT32_MAX ? (uint64_t)count * 16 + 1024 : UINT32_MAX;
+        for (uint32_t n = 0; n < bucket_total && built; n++)
+        {
+            const uint32_t *bucket_keys = &keys[start[order[n]]];
+            const uint32_t size = start[order[n] + 1] - start[order[n]];
+            bool fits = false;
+            for (uint32_t displacement = 0; displacement < attempts && !fits; displacement++)
+            {
+                uint32_t k = 0;
+                for (; k < size; k++)
+                {
+                    const uint32_t slot = slot_of_(hashes[bucket_keys[k]], displacement, count);
+                    if (taken[slot]) break;
+                    taken[slot] = true;
+                }
+                fits = k == size;
+                if (!fits)
+                {
+                    while (k--) taken[slot_of_(hashes[bucket_keys[k]], displacement, count)] = false;
+                    continue;
+                }
+
+                displacements[order[n]] = displacement;
+                for (k = 0; k < size; k++)
+                {
+                    SnapshotSlot_t *slot = &slots[slot_of_(hashes[bucket_keys[k]], displacement, count)];
+                    slot->hash = (uint32_t)hashes[bucket_keys[k]];
+                    slot->position = items[bucket_keys[k]];
+                }
+            }
+            built = fits;
+        }
+    }
+
+    free(taken);
+    free(order);
+    free(keys);
+    free(fill);
+    free(start);
+    return built;
+}
+
+
+
+// Only the first of several sections or pairs sharing a name is indexed, matching ini_get_value().
+static bool is_indexed_section_(const INIData_t *data, const INISection_t *section)
+{
+    return ini_has_section(data, section->name) == section;
+}
+
+
+
+// Pairs are compared by entry rather than value, which interned values share.
+static bool is_indexed_pair_(const INIData_t *data, const INISection_t *section, const INIEntry_t *entry)
+{
+    const INIHandle_t handle = ini_resolve(data, section->name, entry->key);
+    return handle.generation && ini_pair_at(ini_section_at(data, handle.section), handle.pair) == entry;
+}
+
+
+
+/*
+ * Fills in the perfect hashes of an image whose sections, pairs
+ * and strings are already laid out, trying new seeds until both
+ * hashes can be built.
+ */
+static bool index_image_(const INIData_t *data, SnapshotHeader_t *header, char *image)
+{
+    const uint32_t total = header->indexed_section_count + header->indexed_pair_count;
+    uint64_t *hashes = malloc(sizeof(uint64_t) * ((size_t)total + 1));
+    uint32_t *items = malloc(sizeof(uint32_t) * ((size_t)total + 1));
+    bool indexed = false;
+
+    for (uint64_t seed = 0; hashes && items && !indexed && seed < SNAPSHOT_SEED_ATTEMPTS; seed++)
+    {
+        uint32_t section_key = 0;
+        uint32_t pair_key = header->indexed_section_count;
+        uint32_t pair_position = 0;
+        for (uint32_t i = 0; i < header->section_count; i++)
+        {
+            const INISection_t *section = ini_section_at(data, i);
+            if (!is_indexed_section_(data, section))
+            {
+                pair_position += section->pair_count;
+                continue;
+            }
+            hashes[section_key] = hash_section_(seed, section->name, section->name_length);
+            items[section_key++] = i;
+
+            for (size_t j = 0; j < section->pair_count; j++, pair_position++)
+            {
+                const INIEntry_t *entry = ini_pair_at(section, j);
+                if (!is_indexed_pair_(data, section, entry)) continue;
+                hashes[pair_key] = hash_pair_(seed, section->name, section->name_length, entry->key, entry->key_length);
+                items[pair_key++] = pair_position;
+            }
+        }
+
+        header->hash_seed = seed;
+        const uint32_t sections = header->indexed_section_count;
+        indexed = build_perfect_hash_(hashes, items, sections, header->section_bucket_count,
+                                      (uint32_t *)(image + header->section_displacements_offset),
+                                      (SnapshotSlot_t *)(image + header->section_index_offset))
+                  && build_perfect_hash_(hashes + sections, items + sections, header->indexed_pair_count,
+                                         header->pair_bucket_count,
+                                         (uint32_t *)(image + header->pair_displacements_offset),
+                                         (SnapshotSlot_t *)(image + header->pair_index_offset));
+    }
+
+    free(items);
+    free(hashes);
+    return indexed;
+}
+
+
+
+/*
+ * Lays out `data` as a snapshot image in a single heap allocation
+ * sized exactly to its contents. Returns NULL if the document does
+ * not fit the format.
+ */
+static char *build_image_(const INIData_t *data, const SourceStamp_t *stamp, size_t *image_size)
+{
+    uint64_t pair_count = 0;
+    uint64_t indexed_pair_count = 0;
+    uint32_t indexed_section_count = 0;
+    uint64_t strings_size = 0;
+    if (data->section_count > UINT32_MAX) return NULL;
+    for (size_t i = 0; i < data->section_count; i++)
+    {
+        const INISection_t *section = ini_section_at(data, i);
+        strings_size += section->name_length + 1;
+        pair_count += section->pair_count;
+        for (size_t j = 0; j < section->pair_count; j++)
+        {
+            const INIEntry_t *entry = ini_pair_at(section, j);
+            strings_size += entry->key_length + entry->value_length + 2;
+        }
+
+        if (!is_indexed_section_(data, section)) continue;
+        indexed_section_count++;
+        for (size_t j = 0; j < section->pair_count; j++)
+            indexed_pair_count += is_indexed_pair_(data, section, ini_pair_at(section, j));
+    }
+    if (pair_count > UINT32_MAX / 2 || strings_size > UINT32_MAX) return NULL;
+
+    SnapshotHeader_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.source_size = stamp->size;
+    header.source_mtime = stamp->mtime;
+    header.source_mtime_nsec = stamp->mtime_nsec;
+    header.section_count = (uint32_t)data->section_count;
+    header.pair_count = (uint32_t)pair_count;
+    header.indexed_section_count = indexed_section_count;
+    header.indexed_pair_count = (uint32_t)indexed_pair_count;
+    header.section_bucket_count = bucket_count_(header.indexed_section_count);
+    header.pair_bucket_count = bucket_count_(header.indexed_pair_count);
+
+    size_t offset = align_(sizeof(SnapshotHeader_t));
+    header.sections_offset = offset;
+    offset += align_(sizeof(SnapshotSection_t) * header.section_count);
+    header.pairs_offset = offset;
+    offset += align_(sizeof(SnapshotPair_t) * header.pair_count);
+    header.section_displacements_offset = offset;
+    offset += align_(sizeof(uint32_t) * header.section_bucket_count);
+    header.section_index_offset = offset;
+    offset += align_(sizeof(SnapshotSlot_t) * header.indexed_section_count);
+    header.pair_displacements_offset = offset;
+    offset += align_(sizeof(uint32_t) * header.pair_bucket_count);
+    header.pair_index_offset = offset;
+    offset += align_(sizeof(SnapshotSlot_t) * header.indexed_pair_count);
+    header.strings_offset = offset;
+    header.strings_size = strings_size;
+    offset += align_(strings_size);
+    header.image_size = offset;
+
+    char *image = calloc(1, offset);
+    if (!image) return NULL;
+
+    SnapshotSection_t *sections = (SnapshotSection_t *)(image + header.sections_offset);
+    SnapshotPair_t *pairs = (SnapshotPair_t *)(image + header.pairs_offset);
+    char *strings = image + header.strings_offset;
+
+    uint32_t string_offset = 0;
+    uint32_t pair_position = 0;
+    for (uint32_t i = 0; i < header.section_count; i++)
+    {
+        const INISection_t *section = ini_section_at(data, i);
+        sections[i].name = string_offset;
+        sections[i].name_length = (uint32_t)section->name_length;
+        sections[i].first_pair = pair_position;
+        sections[i].pair_count = (uint32_t)section->pair_count;
+        memcpy(strings + string_offset, section->name, section->name_length + 1);
+        string_offset += (uint32_t)section->name_length + 1;
+
+        for (size_t j = 0; j < section->pair_count; j++, pair_position++)
+        {
+            const INIEntry_t *entry = ini_pair_at(section, j);
+            SnapshotPair_t *pair = &pairs[pair_position];
+            pair->section = i;
+            pair->key = string_offset;
+            pair->key_length = (uint32_t)entry->key_length;
+            memcpy(strings + string_offset, entry->key, entry->key_length + 1);
+            string_offset += (uint32_t)entry->key_length + 1;
+            pair->value = string_offset;
+            memcpy(strings + string_offset, entry->value, entry->value_length + 1);
+            string_offset += (uint32_t)entry->value_length + 1;
+        }
+    }
+
+    if (!index_image_(data, &header, image))
+    {
+        free(image);
+        return NULL;
+    }
+
+    const size_t body = align_(sizeof(SnapshotHeader_t));
+    header.checksum = checksum_(image + body, offset - body);
+    memcpy(image, &header, sizeof(header));
+    *image_size = offset;
+    return image;
+}
+
+
+
+/*
+ * Writes next to the destination and renames, so that readers
+ * never see a partially written snapshot.
+ */
+static bool write_image_(const char *path, const char *image, size_t size)
+{
+    const size_t path_length = strlen(path);
+    char *temp_path = malloc(path_length + sizeof(".tmp"));
+    if (!temp_path) return false;
+    memcpy(temp_path, path, path_length);
+    memcpy(temp_path + path_length, ".tmp", sizeof(".tmp"));
+
+    FILE *file = fopen(temp_path, "wb");
+    bool written = file && fwrite(image, 1, size, file) == size;
+    if (file && fclose(file) != 0) written = false;
+    if (written) written = rename(temp_path, path) == 0;
+    if (!written) remove(temp_path);
+
+    free(temp_path);
+    return written;
+}
+
+
+
+bool ini_write_snapshot(const INIData_t *data, const char *path, const char *source_path)
+{
+    assert(data);
+    assert(path);
+    if (!data || !path || data->error.encountered) return false;
+
+    SourceStamp_t stamp;
+    if (!stamp_source_(source_path, &stamp)) return false;
+
+    size_t size;
+    char *image = build_image_(data, &stamp, &size);
+    if (!image) return false;
+
+    const bool written = write_image_(path, image, size);
+    free(image);
+    return written;
+}
+
+
+
+// Checks that the image is intact, matches this build and is no older than its source.
+static bool validate_image_(const char *image, size_t size, const char *source_path)
+{
+    if (size < sizeof(SnapshotHeader_t)) return false;
+    const SnapshotHeader_t *header = (const SnapshotHeader_t *)image;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) return false;
+    if (header->version != SNAPSHOT_VERSION || header->byte_order != SNAPSHOT_BYTE_ORDER) return false;
+    if (header->image_size != size) return false;
+
+    SourceStamp_t stamp;
+    if (!stamp_source_(source_path, &stamp)) return false;
+    const SourceStamp_t recorded = {header->source_size, header->source_mtime, header->source_mtime_nsec};
+    if (!same_stamp_(&recorded, &stamp)) return false;
+
+    const uint64_t regions[][2] = {
+        {header->sections_offset, sizeof(SnapshotSection_t) * (uint64_t)header->section_count},
+        {header->pairs_offset, sizeof(SnapshotPair_t) * (uint64_t)header->pair_count},
+        {header->section_displacements_offset, sizeof(uint32_t) * (uint64_t)header->section_bucket_count},
+        {header->section_index_offset, sizeof(SnapshotSlot_t) * (uint64_t)header->indexed_section_count},
+        {header->pair_displacements_offset, sizeof(uint32_t) * (uint64_t)header->pair_bucket_count},
+        {header->pair_index_offset, sizeof(SnapshotSlot_t) * (uint64_t)header->indexed_pair_count},
+        {header->strings_offset, header->strings_size},
+    };
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++)
+        if (regions[i][0] % SNAPSHOT_ALIGNMENT || regions[i][0] > size || regions[i][1] > size - regions[i][0])
+            return false;
+    if (!header->section_bucket_count || !header->pair_bucket_count
+        || header->indexed_section_count > header->section_count || header->indexed_pair_count > header->pair_count)
+        return false;
+
+    const SnapshotSlot_t *section_index = (const SnapshotSlot_t *)(image + header->section_index_offset);
+    for (uint32_t i = 0; i < header->indexed_section_count; i++)
+        if (section_index[i].position >= header->section_count) return false;
+    const SnapshotSlot_t *pair_index = (const SnapshotSlot_t *)(image + header->pair_index_offset);
+    for (uint32_t i = 0; i < header->indexed_pair_count; i++)
+        if (pair_index[i].position >= header->pair_count) return false;
+
+    const size_t body = align_(sizeof(SnapshotHeader_t));
+    return header->checksum == checksum_(image + body, size - body);
+}
+
+
+
+static INISnapshot_t *wrap_image_(char *image, size_t size, bool mapped)
+{
+    INISnapshot_t *snapshot = malloc(sizeof(INISnapshot_t));
+    if (!snapshot) return NULL;
+
+    const SnapshotHeader_t *header = (const SnapshotHeader_t *)image;
+    snapshot->image = image;
+    snapshot->size = size;
+    snapshot->mapped = mapped;
+    snapshot->header = header;
+    snapshot->sections = (const SnapshotSection_t *)(image + header->sections_offset);
+    snapshot->pairs = (const SnapshotPair_t *)(image + header->pairs_offset);
+    snapshot->section_displacements = (const uint32_t *)(image + header->section_displacements_offset);
+    snapshot->section_index = (const SnapshotSlot_t *)(image + header->section_index_offset);
+    snapshot->pair_displacements = (const uint32_t *)(image + header->pair_displacements_offset);
+    snapshot->pair_index = (const SnapshotSlot_t *)(image + header->pair_index_offset);
+    snapshot->strings = image + header->strings_offset;
+    return snapshot;
+}
+
+
+
+static void release_image_(char *image, size_t size, bool mapped)
+{
+#ifdef INI_USE_MMAP
+    if (mapped)
+    {
+        munmap(image, size);
+        return;
+    }
+#endif
+    (void)size;
+    (void)mapped;
+    free(image);
+}
+
+
+
+// Maps a snapshot file read-only, or reads it into memory where that is not possible.
+static char *open_image_(const char *path, size_t *size, bool *mapped)
+{
+    *mapped = false;
+
+#ifdef INI_USE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    *mapped = true;
+    return map;
+#else
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    char *image = NULL;
+    long length = -1;
+    if (fseek(file, 0, SEEK_END) == 0) length = ftell(file);
+    if (length > 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        image = malloc((size_t)length);
+        if (image && fread(image, 1, (size_t)length, file) != (size_t)length)
+        {
+            free(image);
+            image = NULL;
+        }
+    }
+    fclose(file);
+    *size = (size_t)length;
+    return image;
+#endif
+}
+
+
+
+INISnapshot_t *ini_freeze(const INIData_t *data)
+{
+    assert(data);
+    if (!data || data->error.encountered) return NULL;
+
+    const SourceStamp_t stamp = {0};
+    size_t size;
+    char *image = build_image_(data, &stamp, &size);
+    if (!image) return NULL;
+
+    INISnapshot_t *snapshot = wrap_image_(image, size, false);
+    if (!snapshot) free(image);
+    return snapshot;
+}
+
+
+
+INISnapshot_t *ini_load_snapshot(const char *path, const char *source_path)
+{
+    assert(path);
+    if (!path) return NULL;
+
+    size_t size;
+    bool mapped;
+    char *image = open_image_(path, &size, &mapped);
+    if (image)
+    {
+        if (validate_image_(image, size, source_path))
+        {
+            INISnapshot_t *snapshot = wrap_image_(image, size, mapped);
+            if (!snapshot) release_image_(image, size, mapped);
+            return snapshot;
+        }
+        release_image_(image, size, mapped);
+    }
+
+    // Missing, damaged or stale: fall back to the text file.
+    // The stamp is taken before parsing so an edit made meanwhile can never be recorded as parsed.
+    SourceStamp_t stamp;
+    if (!source_path || !stamp_source_(source_path, &stamp)) return NULL;
+    INIData_t *data = ini_parse_mapped(source_path);
+    if (!data || data->error.encountered)
+    {
+        ini_free(data);
+        return NULL;
+    }
+
+    image = build_image_(data, &stamp, &size);
+    ini_free(data);
+    if (!image) return NULL;
+
+    // Refreshing the snapshot on disk is best effort; the image in memory is used either way. It is
+    // skipped when the source changed while it was parsed, so the next load parses the new text.
+    SourceStamp_t after;
+    if (stamp_source_(source_path, &after) && same_stamp_(&stamp, &after)) write_image_(path, image, size);
+
+    INISnapshot_t *snapshot = wrap_image_(image, size, false);
+    if (!snapshot) free(image);
+    return snapshot;
+}
+
+
+
+void ini_snapshot_free(INISnapshot_t *snapshot)
+{
+    if (!snapshot) return;
+    release_image_(snapshot->image, snapshot->size, snapshot->mapped);
+    free(snapshot);
+}
+
+
+
+bool ini_snapshot_has_section(const INISnapshot_t *snapshot, const char *section)
+{
+    assert(snapshot);
+    assert(section);
+    if (!snapshot || !section) return false;
+
+    const SnapshotHeader_t *header = snapshot->header;
+    if (!header->indexed_section_count) return false;
+
+    const size_t length = strlen(section);
+    const uint64_t hash = hash_section_(header->hash_seed, section, length);
+    const uint32_t displacement = snapshot->section_displacements[bucket_of_(hash, header->section_bucket_count)];
+    const SnapshotSlot_t *slot = &snapshot->section_index[slot_of_(hash, displacement, header->indexed_section_count)];
+    const SnapshotSection_t *candidate = &snapshot->sections[slot->position];
+    return slot->hash == (uint32_t)hash && candidate->name_length == length
+           && memcmp(image_string_(snapshot->strings, candidate->name), section, length) == 0;
+}
+
+
+
+const char *ini_snapshot_get_value(const INISnapshot_t *snapshot, const char *section, const char *key)
+{
+    assert(snapshot);
+    assert(section);
+    assert(key);
+    if (!snapshot || !section || !key) return NULL;
+
+    const SnapshotHeader_t *header = snapshot->header;
+    if (!header->indexed_pair_count) return NULL;
+
+    const size_t section_length = strlen(section);
+    const size_t key_length = strlen(key);
+    const uint64_t hash = hash_pair_(header->hash_seed, section, section_length, key, key_length);
+    const uint32_t displacement = snapshot->pair_displacements[bucket_of_(hash, header->pair_bucket_count)];
+    const SnapshotSlot_t *slot = &snapshot->pair_index[slot_of_(hash, displacement, header->indexed_pair_count)];
+    const SnapshotPair_t *pair = &snapshot->pairs[slot->position];
+    if (slot->hash != (uint32_t)hash
+        || !pair_matches_(snapshot->sections, pair, snapshot->strings, section, section_length, key, key_length))
+        return NULL;
+    return image_string_(snapshot->strings, pair->value);
+}
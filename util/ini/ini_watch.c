@@ -0,0 +1,215 @@
+#include "ini.h"
+
+
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#define INI_USE_INOTIFY
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+
+
+struct INIWatcher
+{
+    int fd;
+    char *path;
+    const char *name;
+    INIData_t *data;
+    INIDiffHandler_t handler;
+    void *user;
+};
+
+
+
+#ifdef INI_USE_INOTIFY
+
+static INIData_t *parse_path_(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) return NULL;
+    INIData_t *data = ini_parse_file(file);
+    fclose(file);
+    return data;
+}
+
+
+
+/*
+ * The directory is watched rather than the file, since editors
+ * usually replace the file and a watch on it would be lost.
+ */
+static bool add_watch_(INIWatcher_t *watcher)
+{
+    char *slash = strrchr(watcher->path, '/');
+    watcher->name = slash ? slash + 1 : watcher->path;
+
+    int wd;
+    if (!slash)
+        wd = inotify_add_watch(watcher->fd, ".", WATCH_EVENTS);
+    else if (slash == watcher->path)
+        wd = inotify_add_watch(watcher->fd, "/", WATCH_EVENTS);
+    else
+    {
+        *slash = '\0';
+        wd = inotify_add_watch(watcher->fd, watcher->path, WATCH_EVENTS);
+        *slash = '/';
+    }
+    return wd >= 0;
+}
+
+
+
+// Drains pending events, returning true if any of them concern the watched file.
+static bool read_events_(INIWatcher_t *watcher)
+{
+    bool changed = false;
+    _Alignas(struct inotify_event) char buffer[4096];
+    for (;;)
+    {
+        const ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+        if (length <= 0)
+        {
+            if (length < 0 && errno == EINTR) continue;
+            return changed;
+        }
+
+        for (const char *p = buffer; p < buffer + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            if (event->len && strcmp(event->name, watcher->name) == 0) changed = true;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+
+
+INIWatcher_t *ini_watch(const char *path, const INIDiffHandler_t *handler, void *user)
+{
+    assert(path);
+    if (!path) return NULL;
+
+    INIWatcher_t *watcher = calloc(1, sizeof(INIWatcher_t));
+    if (!watcher) return NULL;
+    watcher->fd = -1;
+    if (handler) watcher->handler = *handler;
+    watcher->user = user;
+
+    watcher->path = malloc(strlen(path) + 1);
+    if (!watcher->path) goto watch_failure;
+    strcpy(watcher->path, path);
+
+    // Watch before the first parse so that no change can slip in between.
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd < 0 || !add_watch_(watcher)) goto watch_failure;
+
+    watcher->data = parse_path_(path);
+    if (!watcher->data || watcher->data->error.encountered) goto watch_failure;
+    return watcher;
+
+watch_failure:
+    ini_watch_free(watcher);
+    return NULL;
+}
+
+
+
+bool ini_watch_poll(INIWatcher_t *watcher, int timeout_ms)
+{
+    assert(watcher);
+    if (!watcher) return false;
+
+    struct pollfd pfd = {watcher->fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0 || !read_events_(watcher)) return false;
+
+    INIData_t *update = parse_path_(watcher->path);
+    if (!update) return false;
+    if (update->error.encountered)
+    {
+        if (watcher->handler.on_error)
+        {
+            const INIView_t line = {update->error.line, strlen(update->error.line)};
+            watcher->handler.on_error(watcher->user, line, update->error.offset, update->error.msg);
+        }
+        ini_free(update);
+        return false;
+    }
+
+    if (ini_apply(watcher->data, update, &watcher->handler, watcher->user)) return true;
+    ini_free(update);
+    return false;
+}
+
+
+
+int ini_watch_fd(const INIWatcher_t *watcher)
+{
+    assert(watcher);
+    return watcher ? watcher->fd : -1;
+}
+
+
+
+void ini_watch_free(INIWatcher_t *watcher)
+{
+    if (!watcher) return;
+    if (watcher->fd >= 0) close(watcher->fd);
+    ini_free(watcher->data);
+    free(watcher->path);
+    free(watcher);
+}
+
+#else
+
+INIWatcher_t *ini_watch(const char *path, const INIDiffHandler_t *handler, void *user)
+{
+    (void)path;
+    (void)handler;
+    (void)user;
+    return NULL;
+}
+
+
+
+bool ini_watch_poll(INIWatcher_t *watcher, int timeout_ms)
+{
+    (void)watcher;
+    (void)timeout_ms;
+    return false;
+}
+
+
+
+int ini_watch_fd(const INIWatcher_t *watcher)
+{
+    (void)watcher;
+    return -1;
+}
+
+
+
+void ini_watch_free(INIWatcher_t *watcher)
+{
+    free(watcher);
+}
+
+#endif
+
+
+
+INIData_t *ini_watch_data(const INIWatcher_t *watcher)
+{
+    assert(watcher);
+    return watcher ? watcher->data : NULL;
+}
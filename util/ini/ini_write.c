@@ -0,0 +1,282 @@
+#include "ini.h"
+
+
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define INI_USE_FD
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+
+
+#define WRITER_BUFFER_SIZE 65536
+
+
+
+static size_t section_size_(size_t name_length)
+{
+    return name_length + sizeof("[]\n") - 1;
+}
+
+
+
+static size_t pair_size_(size_t key_length, size_t value_length)
+{
+    return key_length + value_length + sizeof("=\n") - 1;
+}
+
+
+
+static char *put_section_(char *out, const char *name, size_t length)
+{
+    *out++ = '[';
+    memcpy(out, name, length);
+    out += length;
+    *out++ = ']';
+    *out++ = '\n';
+    return out;
+}
+
+
+
+static char *put_pair_(char *out, const char *key, size_t key_length, const char *value, size_t value_length)
+{
+    memcpy(out, key, key_length);
+    out += key_length;
+    *out++ = '=';
+    memcpy(out, value, value_length);
+    out += value_length;
+    *out++ = '\n';
+    return out;
+}
+
+
+
+size_t ini_write_size(const INIData_t *data)
+{
+    assert(data);
+    if (!data) return 0;
+
+    size_t size = 0;
+    for (size_t i = 0; i < data->section_count; i++)
+    {
+        const INISection_t *section = ini_section_at(data, i);
+        size += section_size_(section->name_length);
+        for (size_t j = 0; j < section->pair_count; j++)
+        {
+            const INIEntry_t *entry = ini_pair_at(section, j);
+            size += pair_size_(entry->key_length, entry->value_length);
+        }
+    }
+    return size;
+}
+
+
+
+size_t ini_write_buffer(const INIData_t *data, char *buffer, size_t size)
+{
+    assert(data);
+    if (!data) return 0;
+
+    const size_t needed = ini_write_size(data);
+    if (!buffer || size < needed) return needed;
+
+    char *out = buffer;
+    for (size_t i = 0; i < data->section_count; i++)
+    {
+        const INISection_t *section = ini_section_at(data, i);
+        out = put_section_(out, section->name, section->name_length);
+        for (size_t j = 0; j < section->pair_count; j++)
+        {
+            const INIEntry_t *entry = ini_pair_at(section, j);
+            out = put_pair_(out, entry->key, entry->key_length, entry->value, entry->value_length);
+        }
+    }
+    return needed;
+}
+
+
+
+char *ini_write_string(const INIData_t *data, size_t *length)
+{
+    assert(data);
+    if (!data) return NULL;
+
+    const size_t size = ini_write_size(data);
+    char *buffer = malloc(size + 1);
+    if (!buffer) return NULL;
+    ini_write_buffer(data, buffer, size);
+    buffer[size] = '\0';
+    if (length) *length = size;
+    return buffer;
+}
+
+
+
+bool ini_write_file(const INIData_t *data, FILE *file)
+{
+    assert(data);
+    assert(file);
+    if (!data || !file) return false;
+
+    INIWriter_t writer;
+    ini_writer_init(&writer, file);
+    for (size_t i = 0; i < data->section_count; i++)
+    {
+        const INISection_t *section = ini_section_at(data, i);
+        const INIView_t name = {section->name, section->name_length};
+        ini_writer_begin_section(&writer, name);
+        for (size_t j = 0; j < section->pair_count; j++)
+        {
+            const INIEntry_t *entry = ini_pair_at(section, j);
+            const INIView_t key = {entry->key, entry->key_length};
+            const INIView_t value = {entry->value, entry->value_length};
+            ini_writer_pair(&writer, key, value);
+        }
+    }
+    const bool written = ini_writer_flush(&writer);
+    ini_writer_free(&writer);
+    return written;
+}
+
+
+
+#ifdef INI_USE_FD
+
+// Retries short writes, which write() is allowed to make.
+static bool write_all_(int fd, const char *bytes, size_t length)
+{
+    while (length)
+    {
+        const ssize_t written = write(fd, bytes, length);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+
+
+bool ini_write_fd(const INIData_t *data, int fd)
+{
+    assert(data);
+    if (!data || fd < 0) return false;
+
+    size_t length;
+    char *buffer = ini_write_string(data, &length);
+    if (!buffer) return false;
+    const bool written = write_all_(fd, buffer, length);
+    free(buffer);
+    return written;
+}
+
+#else
+
+bool ini_write_fd(const INIData_t *data, int fd)
+{
+    (void)data;
+    (void)fd;
+    return false;
+}
+
+#endif
+
+
+
+void ini_writer_init(INIWriter_t *writer, FILE *file)
+{
+    assert(writer);
+    if (!writer) return;
+    writer->buffer = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+    writer->file = file;
+    writer->failed = false;
+}
+
+
+
+// Makes room for `size` more bytes, flushing first when writing to a file.
+static char *reserve_(INIWriter_t *writer, size_t size)
+{
+    if (writer->failed) return NULL;
+    if (writer->file && writer->capacity - writer->length < size && !ini_writer_flush(writer)) return NULL;
+
+    if (writer->capacity - writer->length < size)
+    {
+        size_t capacity = writer->capacity ? writer->capacity : WRITER_BUFFER_SIZE;
+        while (capacity - writer->length < size) capacity *= 2;
+        char *re = realloc(writer->buffer, capacity);
+        if (!re)
+        {
+            writer->failed = true;
+            return NULL;
+        }
+        writer->buffer = re;
+        writer->capacity = capacity;
+    }
+
+    char *out = writer->buffer + writer->length;
+    writer->length += size;
+    return out;
+}
+
+
+
+bool ini_writer_begin_section(INIWriter_t *writer, INIView_t name)
+{
+    assert(writer);
+    char *out = writer ? reserve_(writer, section_size_(name.length)) : NULL;
+    if (!out) return false;
+    put_section_(out, name.ptr, name.length);
+    return true;
+}
+
+
+
+bool ini_writer_pair(INIWriter_t *writer, INIView_t key, INIView_t value)
+{
+    assert(writer);
+    char *out = writer ? reserve_(writer, pair_size_(key.length, value.length)) : NULL;
+    if (!out) return false;
+    put_pair_(out, key.ptr, key.length, value.ptr, value.length);
+    return true;
+}
+
+
+
+bool ini_writer_flush(INIWriter_t *writer)
+{
+    assert(writer);
+    if (!writer || writer->failed) return false;
+    if (!writer->file || !writer->length) return true;
+
+    if (fwrite(writer->buffer, 1, writer->length, writer->file) != writer->length)
+    {
+        writer->failed = true;
+        return false;
+    }
+    writer->length = 0;
+    return true;
+}
+
+
+
+void ini_writer_free(INIWriter_t *writer)
+{
+    if (!writer) return;
+    free(writer->buffer);
+    writer->buffer = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+}